@@ -0,0 +1,713 @@
+/*
+ *Copyright 2017 Lukasz Towarek
+ *
+ *Licensed under the Apache License, Version 2.0 (the "License");
+ *you may not use this file except in compliance with the License.
+ *You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *Unless required by applicable law or agreed to in writing, software
+ *distributed under the License is distributed on an "AS IS" BASIS,
+ *WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *See the License for the specific language governing permissions and
+ *limitations under the License.
+ */
+
+#include "triangle.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+struct BenchSettings {
+  uint32_t frame_count = 1000;
+  uint32_t warmup_frame_count = 100;
+  uint32_t width = 1280;
+  uint32_t height = 720;
+  bool is_headless = false;
+  bool is_cold_start = false;
+  bool is_dedup_benchmark = false;
+  bool is_recording_benchmark = false;
+  bool is_culling_benchmark = false;
+  bool is_mesh_optimization_benchmark = false;
+  std::string output_path;
+  std::string trace_path;
+  vka::ControllerSettings controller_settings;
+};
+
+vk::PresentModeKHR parse_present_mode(const std::string &name) {
+  if (name == "fifo") {
+    return vk::PresentModeKHR::eFifo;
+  } else if (name == "fifo_relaxed") {
+    return vk::PresentModeKHR::eFifoRelaxed;
+  } else if (name == "mailbox") {
+    return vk::PresentModeKHR::eMailbox;
+  } else if (name == "immediate") {
+    return vk::PresentModeKHR::eImmediate;
+  }
+  throw std::runtime_error("Unknown present mode: " + name);
+}
+
+vka::VertexLayout parse_vertex_layout(const std::string &name) {
+  if (name == "full") {
+    return vka::VertexLayout::full;
+  } else if (name == "compact") {
+    return vka::VertexLayout::compact;
+  } else if (name == "quantized") {
+    return vka::VertexLayout::quantized;
+  }
+  throw std::runtime_error("Unknown vertex layout: " + name);
+}
+
+vka::TransformMode parse_transform_mode(const std::string &name) {
+  if (name == "uniform") {
+    return vka::TransformMode::uniform_buffer;
+  } else if (name == "push") {
+    return vka::TransformMode::push_constants;
+  }
+  throw std::runtime_error("Unknown transform mode: " + name);
+}
+
+std::string to_string(const vka::VertexLayout layout) {
+  switch (layout) {
+  case vka::VertexLayout::compact:
+    return "compact";
+  case vka::VertexLayout::quantized:
+    return "quantized";
+  default:
+    return "full";
+  }
+}
+
+std::string to_string(const vka::TransformMode mode) {
+  return mode == vka::TransformMode::push_constants ? "push" : "uniform";
+}
+
+BenchSettings parse_arguments(int argc, char *argv[]) {
+  BenchSettings settings;
+  settings.controller_settings.pipeline_cache_file_name = "pipeline_cache.bin";
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    if (argument == "--headless") {
+      settings.is_headless = true;
+      continue;
+    }
+    if (argument == "--cold-start") {
+      settings.is_cold_start = true;
+      continue;
+    }
+    if (argument == "--dedup") {
+      settings.is_dedup_benchmark = true;
+      continue;
+    }
+    if (argument == "--recording-scaling") {
+      settings.is_recording_benchmark = true;
+      continue;
+    }
+    if (argument == "--culling") {
+      settings.is_culling_benchmark = true;
+      continue;
+    }
+    if (argument == "--mesh-optimization") {
+      settings.is_mesh_optimization_benchmark = true;
+      continue;
+    }
+    if (argument == "--no-culling") {
+      settings.controller_settings.is_culling_enabled = false;
+      continue;
+    }
+    if (argument == "--no-pipeline-statistics") {
+      settings.controller_settings.is_pipeline_statistics_enabled = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      throw std::runtime_error("Missing value for " + argument);
+    }
+    const std::string value = argv[++i];
+    if (argument == "--frames") {
+      settings.frame_count = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--warmup") {
+      settings.warmup_frame_count = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--width") {
+      settings.width = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--height") {
+      settings.height = static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--instances") {
+      settings.controller_settings.instance_count =
+          static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--objects") {
+      settings.controller_settings.object_count =
+          static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--recording-threads") {
+      settings.controller_settings.recording_thread_count =
+          static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--frames-in-flight") {
+      settings.controller_settings.frames_in_flight =
+          static_cast<uint32_t>(std::stoul(value));
+    } else if (argument == "--vertex-layout") {
+      settings.controller_settings.vertex_layout = parse_vertex_layout(value);
+    } else if (argument == "--transform-mode") {
+      settings.controller_settings.transform_mode =
+          parse_transform_mode(value);
+    } else if (argument == "--present-mode") {
+      settings.controller_settings.present_mode = parse_present_mode(value);
+    } else if (argument == "--pipeline-cache") {
+      settings.controller_settings.pipeline_cache_file_name = value;
+    } else if (argument == "--output") {
+      settings.output_path = value;
+    } else if (argument == "--trace") {
+#ifdef VKA_ENABLE_PROFILER
+      settings.trace_path = value;
+#else
+      throw std::runtime_error("Rebuild with VKA_ENABLE_PROFILER for --trace");
+#endif
+    } else {
+      throw std::runtime_error("Unknown argument: " + argument);
+    }
+  }
+  return settings;
+}
+
+struct LegacyVertexHash {
+  size_t operator()(const vka::Vertex &vertex) const {
+    return ((std::hash<glm::vec3>()(vertex.position) ^
+             (std::hash<glm::vec3>()(vertex.color) << 1)) >>
+            1) ^
+           (std::hash<glm::vec2>()(vertex.texture_coordinates) << 1);
+  }
+};
+
+void deduplicate_with_unordered_map(const std::vector<vka::Vertex> &vertices,
+                                    std::vector<vka::Vertex> &unique_vertices,
+                                    std::vector<uint32_t> &indices) {
+  std::unordered_map<vka::Vertex, uint32_t, LegacyVertexHash> vertex_indices;
+  for (const auto &vertex : vertices) {
+    if (vertex_indices.count(vertex) == 0) {
+      vertex_indices[vertex] = static_cast<uint32_t>(unique_vertices.size());
+      unique_vertices.push_back(vertex);
+    }
+    indices.push_back(vertex_indices[vertex]);
+  }
+}
+
+double measure_deduplication(const std::vector<vka::Vertex> &vertices,
+                             const uint32_t thread_count,
+                             std::vector<vka::Vertex> &unique_vertices,
+                             std::vector<uint32_t> &indices) {
+  const uint32_t repetition_count = 5;
+  double best_time = 0.0;
+  for (uint32_t i = 0; i < repetition_count; ++i) {
+    unique_vertices.clear();
+    indices.clear();
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    if (thread_count == 0) {
+      deduplicate_with_unordered_map(vertices, unique_vertices, indices);
+    } else {
+      vka::deduplicate_vertices(vertices, thread_count, unique_vertices,
+                                indices);
+    }
+    const double time = vka::get_elapsed_milliseconds(
+        start_time, std::chrono::high_resolution_clock::now());
+    best_time = i == 0 ? time : std::min(best_time, time);
+  }
+  return best_time;
+}
+
+int run_dedup_benchmark() {
+  const std::vector<vka::Vertex> vertices =
+      vka::load_obj_vertices("chalet.obj");
+  const uint32_t thread_count =
+      std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<vka::Vertex> reference_vertices;
+  std::vector<uint32_t> reference_indices;
+  const double reference_time = measure_deduplication(
+      vertices, 0, reference_vertices, reference_indices);
+
+  std::vector<vka::Vertex> unique_vertices;
+  std::vector<uint32_t> indices;
+  const double single_thread_time =
+      measure_deduplication(vertices, 1, unique_vertices, indices);
+  const double multi_thread_time =
+      measure_deduplication(vertices, thread_count, unique_vertices, indices);
+  const bool is_matching = unique_vertices == reference_vertices &&
+                           indices == reference_indices;
+
+  std::cout << "{\n";
+  std::cout << "  \"model\": \"chalet.obj\",\n";
+  std::cout << "  \"indices\": " << vertices.size() << ",\n";
+  std::cout << "  \"unique_vertices\": " << unique_vertices.size() << ",\n";
+  std::cout << "  \"threads\": " << thread_count << ",\n";
+  std::cout << "  \"unit\": \"ms\",\n";
+  std::cout << "  \"unordered_map\": " << reference_time << ",\n";
+  std::cout << "  \"flat_table_single_thread\": " << single_thread_time
+            << ",\n";
+  std::cout << "  \"flat_table_multi_thread\": " << multi_thread_time
+            << ",\n";
+  std::cout << "  \"matches_reference\": " << (is_matching ? "true" : "false")
+            << "\n";
+  std::cout << "}\n";
+  return is_matching ? 0 : 1;
+}
+
+void write_vertex_cache_statistics(std::ostream &stream,
+                                   const std::string &name,
+                                   const std::vector<uint32_t> &indices,
+                                   const uint32_t vertex_count) {
+  stream << "  \"" << name << "\": {";
+  const uint32_t cache_sizes[] = {16, vka::vertex_cache_size};
+  for (size_t i = 0; i < 2; ++i) {
+    const vka::VertexCacheStatistics statistics =
+        vka::analyze_vertex_cache(indices, vertex_count, cache_sizes[i]);
+    stream << (i > 0 ? ", " : "") << "\"cache_" << cache_sizes[i]
+           << "\": {\"acmr\": " << statistics.acmr
+           << ", \"atvr\": " << statistics.atvr << "}";
+  }
+  stream << "}";
+}
+
+int run_mesh_optimization_benchmark() {
+  std::vector<vka::Vertex> vertices;
+  std::vector<uint32_t> indices;
+  vka::deduplicate_vertices(vka::load_obj_vertices("chalet.obj"),
+                            std::max(1u, std::thread::hardware_concurrency()),
+                            vertices, indices);
+  const uint32_t vertex_count = static_cast<uint32_t>(vertices.size());
+
+  std::cout << "{\n";
+  std::cout << "  \"model\": \"chalet.obj\",\n";
+  std::cout << "  \"triangles\": " << indices.size() / 3 << ",\n";
+  std::cout << "  \"vertices\": " << vertex_count << ",\n";
+  write_vertex_cache_statistics(std::cout, "original", indices, vertex_count);
+  std::cout << ",\n";
+
+  std::vector<vka::Vertex> cache_vertices = vertices;
+  std::vector<uint32_t> cache_indices = indices;
+  auto start_time = std::chrono::high_resolution_clock::now();
+  vka::optimize_mesh(cache_vertices, cache_indices, false);
+  const double cache_time = vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
+  write_vertex_cache_statistics(std::cout, "vertex_cache", cache_indices,
+                                vertex_count);
+  std::cout << ",\n";
+
+  start_time = std::chrono::high_resolution_clock::now();
+  vka::optimize_mesh(vertices, indices, true);
+  const double overdraw_time = vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
+  write_vertex_cache_statistics(std::cout, "vertex_cache_and_overdraw",
+                                indices, vertex_count);
+  std::cout << ",\n";
+
+  std::cout << "  \"unit\": \"ms\",\n";
+  std::cout << "  \"vertex_cache_time\": " << cache_time << ",\n";
+  std::cout << "  \"vertex_cache_and_overdraw_time\": " << overdraw_time
+            << "\n";
+  std::cout << "}\n";
+  return 0;
+}
+
+void write_output(const BenchSettings &settings, const std::string &json) {
+  if (settings.output_path.empty()) {
+    std::cout << json;
+  } else {
+    std::ofstream file(settings.output_path);
+    file << json;
+  }
+}
+
+int run_recording_benchmark(const BenchSettings &settings) {
+  const uint32_t max_thread_count =
+      std::max(1u, std::thread::hardware_concurrency());
+  const vka::Version application_version = {0, 1, 0};
+
+  std::ostringstream stream;
+  stream << "{\n";
+  stream << "  \"objects\": " << settings.controller_settings.object_count
+         << ",\n";
+  stream << "  \"frames\": " << settings.frame_count << ",\n";
+  stream << "  \"unit\": \"ms\",\n";
+  stream << "  \"recording_time\": [";
+  for (uint32_t thread_count = 1;;
+       thread_count = std::min(thread_count * 2, max_thread_count)) {
+    vka::ControllerSettings controller_settings = settings.controller_settings;
+    controller_settings.recording_thread_count = thread_count;
+    vka::VulkanController controller(controller_settings);
+    controller.initialize(
+        vka::create_instance("Bench", application_version, {}, {}),
+        vk::Extent2D(settings.width, settings.height));
+
+    std::vector<double> recording_times;
+    for (uint32_t i = 0; i < settings.warmup_frame_count + settings.frame_count;
+         ++i) {
+      controller.update();
+      controller.draw();
+      if (i >= settings.warmup_frame_count) {
+        recording_times.push_back(controller.get_recording_time());
+      }
+    }
+    controller.wait_idle();
+    controller.release();
+
+    const vka::FrameTimeStatistics statistics =
+        vka::compute_frame_time_statistics(recording_times);
+    stream << (thread_count > 1 ? ", " : "") << "{\"threads\": " << thread_count
+           << ", \"mean\": " << statistics.mean
+           << ", \"p50\": " << statistics.p50
+           << ", \"p95\": " << statistics.p95
+           << ", \"max\": " << statistics.max << "}";
+    if (thread_count == max_thread_count) {
+      break;
+    }
+  }
+  stream << "]\n}\n";
+  write_output(settings, stream.str());
+  return 0;
+}
+
+int run_culling_benchmark(const BenchSettings &settings) {
+  const uint32_t instance_count = 1000000;
+  const uint32_t repetition_count = 10;
+  const std::vector<vka::InstanceData> instances =
+      vka::get_instance_grid(instance_count);
+  const vka::InstanceBounds bounds =
+      vka::get_instance_bounds(instances, {glm::vec3(0.0f), 1.0f});
+
+  const glm::mat4 view =
+      glm::lookAt(glm::vec3(0.5f, 0.5f, 1.0f), glm::vec3(0.5f, 0.5f, 0.0f),
+                  glm::vec3(0.0f, 1.0f, 0.0f));
+  const glm::mat4 projection = glm::perspective(
+      glm::radians(45.0f), settings.width / static_cast<float>(settings.height),
+      0.1f, 10.0f);
+  const vka::Frustum frustum = vka::extract_frustum(projection * view);
+
+  std::vector<uint32_t> visible_instances;
+  double best_time = 0.0;
+  for (uint32_t i = 0; i < repetition_count; ++i) {
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    vka::cull_instances(frustum, bounds, visible_instances);
+    const double time = vka::get_elapsed_milliseconds(
+        start_time, std::chrono::high_resolution_clock::now());
+    best_time = i == 0 ? time : std::min(best_time, time);
+  }
+
+  std::cout << "{\n";
+  std::cout << "  \"instances\": " << instance_count << ",\n";
+  std::cout << "  \"visible_instances\": " << visible_instances.size()
+            << ",\n";
+  std::cout << "  \"unit\": \"ms\",\n";
+  std::cout << "  \"cull_time_per_million_instances\": "
+            << best_time * 1000000.0 / instance_count << "\n";
+  std::cout << "}\n";
+  return 0;
+}
+
+void write_statistics(std::ostream &stream, const std::string &name,
+                      const vka::FrameTimeStatistics &statistics) {
+  stream << "  \"" << name << "\": {\"mean\": " << statistics.mean
+         << ", \"p50\": " << statistics.p50 << ", \"p95\": " << statistics.p95
+         << ", \"p99\": " << statistics.p99 << ", \"max\": " << statistics.max
+         << "}";
+}
+
+void write_pipeline_statistics(
+    std::ostream &stream,
+    const std::vector<vka::PipelineStatistics> &frame_statistics) {
+  stream << "  \"pipeline_statistics\": ";
+  if (frame_statistics.empty()) {
+    stream << "null";
+    return;
+  }
+  double input_assembly_vertices = 0.0;
+  double input_assembly_primitives = 0.0;
+  double vertex_shader_invocations = 0.0;
+  double clipping_invocations = 0.0;
+  double clipping_primitives = 0.0;
+  double fragment_shader_invocations = 0.0;
+  for (const auto &statistics : frame_statistics) {
+    input_assembly_vertices += statistics.input_assembly_vertices;
+    input_assembly_primitives += statistics.input_assembly_primitives;
+    vertex_shader_invocations += statistics.vertex_shader_invocations;
+    clipping_invocations += statistics.clipping_invocations;
+    clipping_primitives += statistics.clipping_primitives;
+    fragment_shader_invocations += statistics.fragment_shader_invocations;
+  }
+  const double count = static_cast<double>(frame_statistics.size());
+  stream << "{\"input_assembly_vertices\": " << input_assembly_vertices / count
+         << ", \"input_assembly_primitives\": "
+         << input_assembly_primitives / count
+         << ", \"vertex_shader_invocations\": "
+         << vertex_shader_invocations / count
+         << ", \"clipping_invocations\": " << clipping_invocations / count
+         << ", \"clipping_primitives\": " << clipping_primitives / count
+         << ", \"fragment_shader_invocations\": "
+         << fragment_shader_invocations / count << "}";
+}
+
+void write_memory_statistics(
+    std::ostream &stream, const std::vector<vka::MemoryHeapStatistics> &heaps,
+    const std::vector<vka::MemoryResourceStatistics> &resources) {
+  stream << "  \"memory_heaps\": [";
+  for (size_t i = 0; i < heaps.size(); ++i) {
+    stream << (i > 0 ? ", " : "") << "{\"heap_size\": " << heaps[i].heap_size
+           << ", \"allocated_size\": " << heaps[i].allocated_size
+           << ", \"used_size\": " << heaps[i].used_size
+           << ", \"peak_used_size\": " << heaps[i].peak_used_size
+           << ", \"budget\": " << heaps[i].budget
+           << ", \"usage\": " << heaps[i].usage
+           << ", \"largest_free_range\": " << heaps[i].largest_free_range
+           << ", \"block_count\": " << heaps[i].block_count
+           << ", \"allocation_count\": " << heaps[i].allocation_count
+           << ", \"free_range_count\": " << heaps[i].free_range_count << "}";
+  }
+  stream << "],\n";
+  stream << "  \"memory_resources\": [";
+  for (size_t i = 0; i < resources.size(); ++i) {
+    stream << (i > 0 ? ", " : "") << "{\"name\": \"" << resources[i].name
+           << "\", \"heap_index\": " << resources[i].heap_index
+           << ", \"memory_type_index\": " << resources[i].memory_type_index
+           << ", \"live_size\": " << resources[i].live_size
+           << ", \"peak_size\": " << resources[i].peak_size
+           << ", \"live_count\": " << resources[i].live_count
+           << ", \"allocation_count\": " << resources[i].allocation_count
+           << "}";
+  }
+  stream << "]";
+}
+
+std::string
+to_json(const BenchSettings &settings, const double startup_time,
+        const vka::StartupTimings &startup_timings, const bool is_cache_warm,
+        const std::vector<double> &cpu_frame_times,
+        const std::vector<double> &recording_times,
+        const std::vector<double> &culling_times,
+        const std::vector<double> &gpu_frame_times,
+        const bool is_gpu_time_from_timestamps, const double upload_gpu_time,
+        const std::vector<vka::PipelineStatistics> &statistics,
+        const std::vector<vka::MemoryHeapStatistics> &heaps,
+        const std::vector<vka::MemoryResourceStatistics> &resources) {
+  std::ostringstream stream;
+  stream << "{\n";
+  stream << "  \"frames\": " << settings.frame_count << ",\n";
+  stream << "  \"width\": " << settings.width << ",\n";
+  stream << "  \"height\": " << settings.height << ",\n";
+  stream << "  \"instances\": " << settings.controller_settings.instance_count
+         << ",\n";
+  stream << "  \"objects\": " << settings.controller_settings.object_count
+         << ",\n";
+  stream << "  \"frames_in_flight\": "
+         << settings.controller_settings.frames_in_flight << ",\n";
+  stream << "  \"recording_threads\": "
+         << settings.controller_settings.recording_thread_count << ",\n";
+  stream << "  \"culling\": "
+         << (settings.controller_settings.is_culling_enabled ? "true"
+                                                              : "false")
+         << ",\n";
+  stream << "  \"vertex_layout\": \""
+         << to_string(settings.controller_settings.vertex_layout) << "\",\n";
+  stream << "  \"vertex_size\": "
+         << vka::get_vertex_size(settings.controller_settings.vertex_layout)
+         << ",\n";
+  stream << "  \"transform_mode\": \""
+         << to_string(settings.controller_settings.transform_mode) << "\",\n";
+  stream << "  \"present_mode\": \""
+         << vk::to_string(settings.controller_settings.present_mode)
+         << "\",\n";
+  stream << "  \"headless\": " << (settings.is_headless ? "true" : "false")
+         << ",\n";
+  stream << "  \"unit\": \"ms\",\n";
+  stream << "  \"startup_time\": " << startup_time << ",\n";
+  stream << "  \"startup\": {\"mesh_loading\": "
+         << startup_timings.mesh_loading
+         << ", \"texture_loading\": " << startup_timings.texture_loading
+         << ", \"device_creation\": " << startup_timings.device_creation
+         << ", \"pipeline_creation\": " << startup_timings.pipeline_creation
+         << ", \"asset_wait\": " << startup_timings.asset_wait
+         << ", \"upload\": " << startup_timings.upload
+         << ", \"total\": " << startup_timings.total << "},\n";
+  stream << "  \"pipeline_cache\": \"" << (is_cache_warm ? "warm" : "cold")
+         << "\",\n";
+  write_statistics(stream, "cpu_frame_time",
+                   vka::compute_frame_time_statistics(cpu_frame_times));
+  stream << ",\n";
+  write_statistics(stream, "recording_time",
+                   vka::compute_frame_time_statistics(recording_times));
+  stream << ",\n";
+  write_statistics(stream, "culling_time",
+                   vka::compute_frame_time_statistics(culling_times));
+  stream << ",\n";
+  stream << "  \"gpu_time_source\": \""
+         << (is_gpu_time_from_timestamps ? "timestamp" : "serialized")
+         << "\",\n";
+  write_statistics(stream, "gpu_time",
+                   vka::compute_frame_time_statistics(gpu_frame_times));
+  stream << ",\n";
+  stream << "  \"upload_gpu_time\": " << upload_gpu_time << ",\n";
+  write_pipeline_statistics(stream, statistics);
+  stream << ",\n";
+  write_memory_statistics(stream, heaps, resources);
+  stream << "\n}\n";
+  return stream.str();
+}
+
+int main(int argc, char *argv[]) {
+  const BenchSettings settings = parse_arguments(argc, argv);
+  if (settings.is_dedup_benchmark) {
+    return run_dedup_benchmark();
+  }
+  if (settings.is_recording_benchmark) {
+    return run_recording_benchmark(settings);
+  }
+  if (settings.is_culling_benchmark) {
+    return run_culling_benchmark(settings);
+  }
+  if (settings.is_mesh_optimization_benchmark) {
+    return run_mesh_optimization_benchmark();
+  }
+  const std::string application_name = "Bench";
+  if (settings.is_cold_start &&
+      !settings.controller_settings.pipeline_cache_file_name.empty()) {
+    std::remove(settings.controller_settings.pipeline_cache_file_name.c_str());
+  }
+  const vka::Version application_version = {0, 1, 0};
+
+  std::vector<const char *> extension_names;
+  GLFWwindow *window = nullptr;
+  if (!settings.is_headless) {
+    glfwInit();
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    window = glfwCreateWindow(settings.width, settings.height,
+                              application_name.c_str(), nullptr, nullptr);
+    uint32_t glfw_extension_count = 0;
+    const char **glfw_extensions =
+        glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    for (uint32_t i = 0; i < glfw_extension_count; ++i) {
+      extension_names.push_back(glfw_extensions[i]);
+    }
+  }
+
+  vka::add_memory_budget_instance_extension(extension_names);
+  vk::UniqueInstance instance = vka::create_instance(
+      application_name, application_version, extension_names, {});
+
+  vka::VulkanController controller(settings.controller_settings);
+  const vk::Extent2D extent(settings.width, settings.height);
+  const auto startup_start_time = std::chrono::high_resolution_clock::now();
+  if (settings.is_headless) {
+    controller.initialize(std::move(instance), extent);
+  } else {
+    VkSurfaceKHR raw_surface;
+    glfwCreateWindowSurface(*instance, window, nullptr, &raw_surface);
+    vk::UniqueSurfaceKHR surface(raw_surface);
+    controller.initialize(std::move(instance), std::move(surface), extent);
+  }
+  const double startup_time = vka::get_elapsed_milliseconds(
+      startup_start_time, std::chrono::high_resolution_clock::now());
+#ifdef VKA_ENABLE_PROFILER
+  std::vector<vka::ProfileEvent> profile_events;
+  const auto collect_profile_events = [&profile_events]() {
+    const std::vector<vka::ProfileEvent> events = vka::flush_profile_events();
+    profile_events.insert(profile_events.end(), events.begin(), events.end());
+  };
+  collect_profile_events();
+#endif
+
+  for (uint32_t i = 0; i < settings.warmup_frame_count; ++i) {
+    if (window) {
+      glfwPollEvents();
+    }
+    controller.update();
+    controller.draw();
+#ifdef VKA_ENABLE_PROFILER
+    collect_profile_events();
+#endif
+  }
+  controller.wait_idle();
+
+  std::vector<double> cpu_frame_times;
+  cpu_frame_times.reserve(settings.frame_count);
+  std::vector<double> recording_times;
+  recording_times.reserve(settings.frame_count);
+  std::vector<double> culling_times;
+  culling_times.reserve(settings.frame_count);
+  const bool is_gpu_timing_supported = controller.is_gpu_timing_supported();
+  std::vector<double> gpu_frame_times;
+  gpu_frame_times.reserve(settings.frame_count);
+  const bool is_pipeline_statistics_supported =
+      controller.is_pipeline_statistics_supported();
+  std::vector<vka::PipelineStatistics> pipeline_statistics;
+  pipeline_statistics.reserve(settings.frame_count);
+  auto previous_time = std::chrono::high_resolution_clock::now();
+  for (uint32_t i = 0; i < settings.frame_count; ++i) {
+    if (window) {
+      glfwPollEvents();
+    }
+    controller.update();
+    controller.draw();
+    const auto current_time = std::chrono::high_resolution_clock::now();
+    cpu_frame_times.push_back(
+        vka::get_elapsed_milliseconds(previous_time, current_time));
+    recording_times.push_back(controller.get_recording_time());
+    culling_times.push_back(controller.get_culling_time());
+    if (is_gpu_timing_supported) {
+      gpu_frame_times.push_back(controller.get_gpu_time());
+    }
+    if (is_pipeline_statistics_supported) {
+      pipeline_statistics.push_back(controller.get_pipeline_statistics());
+    }
+#ifdef VKA_ENABLE_PROFILER
+    collect_profile_events();
+#endif
+    previous_time = current_time;
+  }
+  controller.wait_idle();
+
+  for (uint32_t i = 0; !is_gpu_timing_supported && i < settings.frame_count;
+       ++i) {
+    if (window) {
+      glfwPollEvents();
+    }
+    controller.update();
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    controller.draw();
+    controller.wait_idle();
+    const auto end_time = std::chrono::high_resolution_clock::now();
+    gpu_frame_times.push_back(
+        vka::get_elapsed_milliseconds(start_time, end_time));
+#ifdef VKA_ENABLE_PROFILER
+    collect_profile_events();
+#endif
+  }
+
+  const std::string json = to_json(
+      settings, startup_time, controller.get_startup_timings(),
+      controller.is_pipeline_cache_warm(), cpu_frame_times, recording_times,
+      culling_times, gpu_frame_times, is_gpu_timing_supported,
+      controller.get_upload_time(), pipeline_statistics,
+      controller.get_memory_statistics(),
+      controller.get_memory_resource_statistics());
+  write_output(settings, json);
+#ifdef VKA_ENABLE_PROFILER
+  if (!settings.trace_path.empty()) {
+    collect_profile_events();
+    vka::write_profile_trace(settings.trace_path, profile_events);
+  }
+#endif
+
+  controller.release();
+  if (window) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ *Copyright 2017 Lukasz Towarek
+ *
+ *Licensed under the Apache License, Version 2.0 (the "License");
+ *you may not use this file except in compliance with the License.
+ *You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *Unless required by applicable law or agreed to in writing, software
+ *distributed under the License is distributed on an "AS IS" BASIS,
+ *WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *See the License for the specific language governing permissions and
+ *limitations under the License.
+ */
+
+#include "triangle.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+vk::Format parse_format(const std::string &name) {
+  if (name == "rgba8") {
+    return vk::Format::eR8G8B8A8Unorm;
+  } else if (name == "bc1") {
+    return vk::Format::eBc1RgbaUnormBlock;
+  } else if (name == "bc3") {
+    return vk::Format::eBc3UnormBlock;
+  }
+  throw std::runtime_error("Unknown texture format: " + name);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3 && !(argc == 5 && std::string(argv[3]) == "--format")) {
+    std::cerr << "Usage: vulkanalia_cook input.jpg output.ktx "
+                 "[--format rgba8|bc1|bc3]"
+              << std::endl;
+    return 1;
+  }
+  const vk::Format format =
+      argc == 5 ? parse_format(argv[4]) : vk::Format::eR8G8B8A8Unorm;
+
+  const vka::Texture texture(argv[1]);
+  if (texture.data == nullptr) {
+    std::cerr << "Failed to load " << argv[1] << std::endl;
+    return 1;
+  }
+
+  const std::vector<std::vector<uint8_t>> mipmaps = vka::generate_mipmaps_rgba8(
+      texture.data.get(), texture.width, texture.height);
+  std::vector<std::vector<uint8_t>> encoded_levels;
+  std::vector<vka::ImageLevel> levels;
+  const uint8_t *image = texture.data.get();
+  uint32_t width = texture.width;
+  uint32_t height = texture.height;
+  for (size_t i = 0; i <= mipmaps.size(); ++i) {
+    encoded_levels.push_back(
+        vka::compress_rgba8(image, width, height, format));
+    levels.push_back({encoded_levels.back().data(),
+                      static_cast<uint32_t>(encoded_levels.back().size()),
+                      width, height});
+    if (i < mipmaps.size()) {
+      image = mipmaps[i].data();
+      width = std::max(width / 2, 1u);
+      height = std::max(height / 2, 1u);
+    }
+  }
+
+  vka::write_ktx(argv[2], format, levels);
+  return 0;
+}
@@ -15,9 +15,16 @@
  */
 
 #include "triangle.hpp"
+#include <string>
 
 int main(int argc, char *argv[]) {
   vka::TriangleApplication application;
-  application.run();
+  if (argc > 1 && std::string(argv[1]) == "--headless") {
+    const uint32_t frame_count =
+        argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 100;
+    application.run_headless(frame_count);
+  } else {
+    application.run();
+  }
   return 0;
 }
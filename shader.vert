@@ -2,14 +2,25 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(binding = 0) uniform UniformBufferObject {
+#ifndef VKA_PUSH_CONSTANT_TRANSFORM
     mat4 model;
+#endif
     mat4 view;
     mat4 proj;
 } ubo;
 
+#ifdef VKA_PUSH_CONSTANT_TRANSFORM
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+} push;
+#endif
+
 layout(location = 0) in vec3 inPosition;
+#ifndef VKA_NO_VERTEX_COLOR
 layout(location = 1) in vec3 inColor;
+#endif
 layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in mat4 inModel;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
@@ -19,7 +30,16 @@ out gl_PerVertex {
 };
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+#ifdef VKA_PUSH_CONSTANT_TRANSFORM
+    mat4 model = push.model;
+#else
+    mat4 model = ubo.model;
+#endif
+    gl_Position = ubo.proj * ubo.view * model * inModel * vec4(inPosition, 1.0);
+#ifdef VKA_NO_VERTEX_COLOR
+    fragColor = vec3(1.0);
+#else
     fragColor = inColor;
+#endif
     fragTexCoord = inTexCoord;
 }
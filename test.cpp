@@ -16,7 +16,12 @@
 
 #include "triangle.hpp"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <numeric>
+#include <thread>
 
 class WindowManager {
 public:
@@ -74,7 +79,8 @@ protected:
   }
   const vk::Device &device() {
     if (!device_) {
-      device_ = vka::create_device(physical_device(), queue_index());
+      device_ = vka::create_device(physical_device(), queue_index(),
+                                   {VK_KHR_SWAPCHAIN_EXTENSION_NAME});
     }
     return *device_;
   }
@@ -113,6 +119,31 @@ protected:
     }
     return *vertex_buffer_memory_;
   }
+  const vk::Buffer &instance_buffer() {
+    if (!instance_buffer_) {
+      instance_buffer_ = vka::create_buffer(
+          device(), sizeof(vka::InstanceData),
+          vk::BufferUsageFlagBits::eVertexBuffer);
+    }
+    return *instance_buffer_;
+  }
+  const vk::DeviceMemory &instance_buffer_memory() {
+    if (!instance_buffer_memory_) {
+      instance_buffer_memory_ = vka::allocate_buffer_memory(
+          device(), instance_buffer(), physical_device().getMemoryProperties(),
+          vk::MemoryPropertyFlagBits::eHostVisible |
+              vk::MemoryPropertyFlagBits::eHostCoherent);
+      device().bindBufferMemory(instance_buffer(), *instance_buffer_memory_,
+                                0);
+      const vka::InstanceData instance = vka::get_instance_grid(1)[0];
+      void *data;
+      device().mapMemory(*instance_buffer_memory_, 0, sizeof(instance),
+                         vk::MemoryMapFlags(), &data);
+      std::memcpy(data, &instance, sizeof(instance));
+      device().unmapMemory(*instance_buffer_memory_);
+    }
+    return *instance_buffer_memory_;
+  }
   const vk::Buffer &index_buffer() {
     if (!index_buffer_) {
       const uint32_t size =
@@ -195,7 +226,7 @@ protected:
   }
   const vk::DescriptorPool &descriptor_pool() {
     if (!descriptor_pool_) {
-      descriptor_pool_ = vka::create_descriptor_pool(device());
+      descriptor_pool_ = vka::create_descriptor_pool(device(), 1);
     }
     return *descriptor_pool_;
   }
@@ -263,7 +294,8 @@ protected:
       const vk::Extent2D extent =
           vka::select_swapchain_extent(capabilities, width, height);
       swapchain_ = vka::create_swapchain(surface_format(), extent, capabilities,
-                                         device(), s, nullptr);
+                                         device(), s, nullptr,
+                                         vk::PresentModeKHR::eFifo);
     }
     return *swapchain_;
   }
@@ -286,21 +318,24 @@ protected:
   }
   const vk::RenderPass &render_pass() {
     if (!render_pass_) {
-      render_pass_ = vka::create_render_pass(device(), surface_format().format);
+      render_pass_ = vka::create_render_pass(device(), surface_format().format,
+                                             vk::ImageLayout::ePresentSrcKHR);
     }
     return *render_pass_;
   }
   const vk::PipelineLayout &pipeline_layout() {
     if (!pipeline_layout_) {
       pipeline_layout_ =
-          vka::create_pipeline_layout(device(), descriptor_set_layout());
+          vka::create_pipeline_layout(device(), descriptor_set_layout(),
+                                      vka::TransformMode::uniform_buffer);
     }
     return *pipeline_layout_;
   }
   const vk::Pipeline &graphics_pipeline() {
     if (!graphics_pipeline_) {
       graphics_pipeline_ = vka::create_graphics_pipeline(
-          device(), render_pass(), swapchain_extent(), pipeline_layout());
+          device(), render_pass(), pipeline_layout(), vk::PipelineCache(),
+          vka::VertexLayout::full, vka::TransformMode::uniform_buffer);
     }
     return *graphics_pipeline_;
   }
@@ -334,7 +369,8 @@ protected:
           device(), texture().width, texture().height,
           vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal,
           vk::ImageUsageFlagBits::eTransferDst |
-              vk::ImageUsageFlagBits::eSampled);
+              vk::ImageUsageFlagBits::eSampled,
+          1);
     }
     return *texture_image_;
   }
@@ -349,8 +385,8 @@ protected:
   }
   const vk::ImageView &texture_image_view() {
     if (!texture_image_view_) {
-      texture_image_view_ =
-          vka::create_texture_image_view(device(), texture_image());
+      texture_image_view_ = vka::create_texture_image_view(
+          device(), texture_image(), vk::Format::eR8G8B8A8Unorm, 1);
     }
     return *texture_image_view_;
   }
@@ -385,7 +421,8 @@ protected:
       depth_image_ =
           vka::create_image(device(), texture().width, texture().height,
                             vk::Format::eD32Sfloat, vk::ImageTiling::eOptimal,
-                            vk::ImageUsageFlagBits::eDepthStencilAttachment);
+                            vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                            1);
     }
     return *depth_image_;
   }
@@ -402,7 +439,7 @@ protected:
     if (!depth_image_view_) {
       depth_image_view_ = vka::create_image_view(
           device(), depth_image(), vk::Format::eD32Sfloat,
-          vk::ImageAspectFlagBits::eDepth);
+          vk::ImageAspectFlagBits::eDepth, 1);
     }
     return *depth_image_view_;
   }
@@ -447,6 +484,8 @@ protected:
     texture_image_memory_.release();
     index_buffer_.release();
     index_buffer_memory_.release();
+    instance_buffer_.release();
+    instance_buffer_memory_.release();
     vertex_buffer_.release();
     vertex_buffer_memory_.release();
     staging_index_buffer_.release();
@@ -508,6 +547,8 @@ private:
   vk::UniqueBuffer staging_index_buffer_ = vk::UniqueBuffer();
   vk::UniqueDeviceMemory vertex_buffer_memory_ = vk::UniqueDeviceMemory();
   vk::UniqueBuffer vertex_buffer_ = vk::UniqueBuffer();
+  vk::UniqueDeviceMemory instance_buffer_memory_ = vk::UniqueDeviceMemory();
+  vk::UniqueBuffer instance_buffer_ = vk::UniqueBuffer();
   vk::UniqueDeviceMemory index_buffer_memory_ = vk::UniqueDeviceMemory();
   vk::UniqueBuffer index_buffer_ = vk::UniqueBuffer();
   vk::UniqueSwapchainKHR swapchain_ = vk::UniqueSwapchainKHR();
@@ -588,6 +629,287 @@ TEST_F(TriangleTest, Returns1Of2GivenDeltaTimeIsHalfSecond) {
                   1 / 2.0f);
 }
 
+TEST_F(TriangleTest, ReturnsNearestRankPercentileOfSortedSamples) {
+  std::vector<double> samples(100);
+  std::iota(samples.begin(), samples.end(), 1.0);
+  EXPECT_DOUBLE_EQ(vka::get_percentile(samples, 95.0), 95.0);
+}
+
+TEST_F(TriangleTest, Returns0PercentileGivenThereAreNoSamples) {
+  EXPECT_DOUBLE_EQ(vka::get_percentile({}, 50.0), 0.0);
+}
+
+TEST_F(TriangleTest, ComputesFrameTimeStatisticsOfUnsortedSamples) {
+  std::vector<double> samples(100);
+  std::iota(samples.rbegin(), samples.rend(), 1.0);
+  const vka::FrameTimeStatistics statistics =
+      vka::compute_frame_time_statistics(samples);
+  EXPECT_DOUBLE_EQ(statistics.mean, 50.5);
+  EXPECT_DOUBLE_EQ(statistics.p50, 50.0);
+  EXPECT_DOUBLE_EQ(statistics.p95, 95.0);
+  EXPECT_DOUBLE_EQ(statistics.p99, 99.0);
+  EXPECT_DOUBLE_EQ(statistics.max, 100.0);
+}
+
+TEST_F(TriangleTest, HashesNegativeAndPositiveZeroVertexEqually) {
+  vka::Vertex vertex = vertices()[0];
+  vertex.position.z = 0.0f;
+  vka::Vertex negative_zero_vertex = vertex;
+  negative_zero_vertex.position.z = -0.0f;
+  EXPECT_EQ(vka::hash_vertex(vertex), vka::hash_vertex(negative_zero_vertex));
+}
+
+TEST_F(TriangleTest, DeduplicatesVerticesInFirstOccurrenceOrder) {
+  std::vector<vka::Vertex> expanded_vertices;
+  for (const auto &index : indices()) {
+    expanded_vertices.push_back(vertices()[index]);
+  }
+  std::vector<vka::Vertex> unique_vertices;
+  std::vector<uint32_t> unique_indices;
+  vka::deduplicate_vertices(expanded_vertices, 1, unique_vertices,
+                            unique_indices);
+  EXPECT_EQ(unique_vertices, vertices());
+  EXPECT_EQ(unique_indices, indices());
+}
+
+TEST_F(TriangleTest, DeduplicatesVerticesDeterministicallyAcrossThreads) {
+  std::vector<vka::Vertex> expanded_vertices;
+  for (uint32_t i = 0; i < 100000; ++i) {
+    vka::Vertex vertex = vertices()[(i * 7) % vertices().size()];
+    vertex.texture_coordinates.x = static_cast<float>((i * 31) % 5000);
+    expanded_vertices.push_back(vertex);
+  }
+  std::vector<vka::Vertex> single_thread_vertices;
+  std::vector<uint32_t> single_thread_indices;
+  vka::deduplicate_vertices(expanded_vertices, 1, single_thread_vertices,
+                            single_thread_indices);
+  std::vector<vka::Vertex> multi_thread_vertices;
+  std::vector<uint32_t> multi_thread_indices;
+  vka::deduplicate_vertices(expanded_vertices, 4, multi_thread_vertices,
+                            multi_thread_indices);
+  EXPECT_EQ(multi_thread_vertices, single_thread_vertices);
+  EXPECT_EQ(multi_thread_indices, single_thread_indices);
+  for (size_t i = 0; i < expanded_vertices.size(); ++i) {
+    ASSERT_EQ(multi_thread_vertices[multi_thread_indices[i]],
+              expanded_vertices[i]);
+  }
+}
+
+TEST_F(TriangleTest, HashesDataWithFnv1a) {
+  const uint8_t data[] = {'a'};
+  EXPECT_EQ(vka::hash_fnv1a(data, 0), 0xcbf29ce484222325ull);
+  EXPECT_EQ(vka::hash_fnv1a(data, 1), 0xaf63dc4c8601ec8cull);
+}
+
+TEST_F(TriangleTest, DoesNotOpenMappedFileGivenItDoesNotExist) {
+  vka::MappedFile file;
+  EXPECT_FALSE(file.open("missing_file.bin"));
+  EXPECT_EQ(file.data(), nullptr);
+}
+
+TEST_F(TriangleTest, MapsFileContents) {
+  vka::write_file("mapped_file.bin", {'v', 'k', 'a'});
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("mapped_file.bin"));
+  ASSERT_EQ(file.size(), 3u);
+  EXPECT_EQ(std::memcmp(file.data(), "vka", 3), 0);
+  file.close();
+  std::remove("mapped_file.bin");
+}
+
+TEST_F(TriangleTest, ThrowsExceptionGivenHashedFileDoesNotExist) {
+  EXPECT_THROW(vka::hash_file("missing_file.bin"), std::runtime_error);
+}
+
+TEST_F(TriangleTest, ReadsMeshCacheWrittenForSameSource) {
+  vka::Model model;
+  model.vertices = vertices();
+  model.indices = indices();
+  vka::write_mesh_cache("model.mesh", 42, model);
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("model.mesh"));
+  vka::MeshView mesh;
+  ASSERT_TRUE(vka::read_mesh_cache(file, 42, mesh));
+  ASSERT_EQ(mesh.vertex_count, vertices().size());
+  ASSERT_EQ(mesh.index_count, indices().size());
+  ASSERT_EQ(mesh.index_type, vk::IndexType::eUint32);
+  EXPECT_EQ(mesh.vertices[1], vertices()[1]);
+  EXPECT_EQ(static_cast<const uint32_t *>(mesh.indices)[4], indices()[4]);
+  file.close();
+  std::remove("model.mesh");
+}
+
+TEST_F(TriangleTest, ReadsShortIndicesFromMeshCache) {
+  vka::Model model;
+  model.vertices = vertices();
+  model.short_indices.assign(indices().begin(), indices().end());
+  model.submeshes = {{0, 6, 0}, {6, 6, 0}};
+  vka::write_mesh_cache("model.mesh", 42, model);
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("model.mesh"));
+  vka::MeshView mesh;
+  ASSERT_TRUE(vka::read_mesh_cache(file, 42, mesh));
+  ASSERT_EQ(mesh.index_type, vk::IndexType::eUint16);
+  ASSERT_EQ(mesh.index_count, indices().size());
+  EXPECT_EQ(static_cast<const uint16_t *>(mesh.indices)[4], indices()[4]);
+  ASSERT_EQ(mesh.submesh_count, 2u);
+  EXPECT_EQ(mesh.submeshes[1].first_index, 6u);
+  file.close();
+  std::remove("model.mesh");
+}
+
+TEST_F(TriangleTest, ReturnsSingleSubMeshGivenSmallMesh) {
+  std::vector<vka::Vertex> mesh_vertices = vertices();
+  std::vector<uint32_t> mesh_indices = indices();
+  std::vector<vka::SubMesh> submeshes;
+  vka::split_mesh(vka::max_short_index_vertex_count, mesh_vertices,
+                  mesh_indices, submeshes);
+  ASSERT_EQ(submeshes.size(), 1u);
+  EXPECT_EQ(submeshes[0].index_count, indices().size());
+  EXPECT_EQ(mesh_vertices, vertices());
+  EXPECT_EQ(mesh_indices, indices());
+}
+
+TEST_F(TriangleTest, SplitsMeshIntoSubMeshesGivenVertexLimit) {
+  std::vector<vka::Vertex> mesh_vertices = vertices();
+  std::vector<uint32_t> mesh_indices = indices();
+  std::vector<vka::SubMesh> submeshes;
+  vka::split_mesh(4, mesh_vertices, mesh_indices, submeshes);
+  ASSERT_EQ(submeshes.size(), 2u);
+  for (const auto &submesh : submeshes) {
+    for (uint32_t i = 0; i < submesh.index_count; ++i) {
+      const uint32_t index = mesh_indices[submesh.first_index + i];
+      ASSERT_LT(index, 4u);
+      EXPECT_EQ(mesh_vertices[submesh.vertex_offset + index],
+                vertices()[indices()[submesh.first_index + i]]);
+    }
+  }
+}
+
+TEST_F(TriangleTest, ReturnsVertexCacheStatisticsGivenIndices) {
+  const vka::VertexCacheStatistics statistics = vka::analyze_vertex_cache(
+      indices(), static_cast<uint32_t>(vertices().size()), 16);
+  EXPECT_FLOAT_EQ(statistics.acmr, 2.0f);
+  EXPECT_FLOAT_EQ(statistics.atvr, 1.0f);
+}
+
+TEST_F(TriangleTest, ReducesAcmrGivenVertexCacheOptimization) {
+  const uint32_t grid_size = 32;
+  std::vector<uint32_t> grid_indices;
+  for (uint32_t x = 0; x < grid_size; ++x) {
+    for (uint32_t y = 0; y < grid_size; ++y) {
+      const uint32_t corner = y * (grid_size + 1) + x;
+      const uint32_t quad[] = {corner,
+                               corner + 1,
+                               corner + grid_size + 1,
+                               corner + grid_size + 1,
+                               corner + 1,
+                               corner + grid_size + 2};
+      grid_indices.insert(grid_indices.end(), quad, quad + 6);
+    }
+  }
+  const uint32_t vertex_count = (grid_size + 1) * (grid_size + 1);
+  std::vector<uint32_t> optimized_indices = grid_indices;
+  vka::optimize_vertex_cache(optimized_indices, vertex_count);
+
+  EXPECT_LT(vka::analyze_vertex_cache(optimized_indices, vertex_count, 16).acmr,
+            vka::analyze_vertex_cache(grid_indices, vertex_count, 16).acmr);
+  const auto get_triangles = [](const std::vector<uint32_t> &triangle_indices) {
+    std::vector<std::vector<uint32_t>> triangles;
+    for (size_t i = 0; i < triangle_indices.size(); i += 3) {
+      std::vector<uint32_t> triangle(triangle_indices.begin() + i,
+                                     triangle_indices.begin() + i + 3);
+      std::rotate(triangle.begin(),
+                  std::min_element(triangle.begin(), triangle.end()),
+                  triangle.end());
+      triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+  };
+  EXPECT_EQ(get_triangles(optimized_indices), get_triangles(grid_indices));
+}
+
+TEST_F(TriangleTest, KeepsAllTrianglesGivenOverdrawOptimization) {
+  std::vector<uint32_t> optimized_indices = indices();
+  vka::optimize_overdraw(vertices(), optimized_indices, 4);
+  ASSERT_EQ(optimized_indices.size(), indices().size());
+  EXPECT_TRUE(std::is_permutation(optimized_indices.begin(),
+                                  optimized_indices.end(), indices().begin()));
+}
+
+TEST_F(TriangleTest, OrdersVerticesByFirstUseGivenVertexFetchOptimization) {
+  std::vector<vka::Vertex> optimized_vertices = vertices();
+  std::vector<uint32_t> optimized_indices = {4, 5, 6, 6, 7, 4,
+                                             0, 1, 2, 2, 3, 0};
+  vka::optimize_vertex_fetch(optimized_vertices, optimized_indices);
+  EXPECT_EQ(optimized_indices, indices());
+  EXPECT_EQ(optimized_vertices[0], vertices()[4]);
+  EXPECT_EQ(optimized_vertices[4], vertices()[0]);
+}
+
+TEST_F(TriangleTest, ReturnsWholeMeshGivenMeshWithoutSubMeshes) {
+  vka::Model model;
+  model.vertices = vertices();
+  model.indices = indices();
+  const std::vector<vka::SubMesh> submeshes =
+      vka::get_submeshes(vka::get_mesh_view(model));
+  ASSERT_EQ(submeshes.size(), 1u);
+  EXPECT_EQ(submeshes[0].first_index, 0u);
+  EXPECT_EQ(submeshes[0].index_count, indices().size());
+}
+
+TEST_F(TriangleTest, RejectsMeshCacheGivenDifferentSourceHash) {
+  vka::Model model;
+  model.vertices = vertices();
+  model.indices = indices();
+  vka::write_mesh_cache("model.mesh", 42, model);
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("model.mesh"));
+  vka::MeshView mesh;
+  EXPECT_FALSE(vka::read_mesh_cache(file, 43, mesh));
+  file.close();
+  std::remove("model.mesh");
+}
+
+TEST_F(TriangleTest, RejectsMeshCacheGivenSubMeshOutOfRange) {
+  vka::Model model;
+  model.vertices = vertices();
+  model.indices = indices();
+  model.submeshes = {{6, 12, 0}};
+  vka::write_mesh_cache("model.mesh", 42, model);
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("model.mesh"));
+  vka::MeshView mesh;
+  EXPECT_FALSE(vka::read_mesh_cache(file, 42, mesh));
+  file.close();
+  std::remove("model.mesh");
+}
+
+TEST_F(TriangleTest, ReplacesExistingMeshCacheGivenNewModel) {
+  vka::Model model;
+  model.vertices = vertices();
+  model.indices = indices();
+  vka::write_mesh_cache("model.mesh", 42, model);
+  vka::write_mesh_cache("model.mesh", 43, model);
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("model.mesh"));
+  vka::MeshView mesh;
+  EXPECT_TRUE(vka::read_mesh_cache(file, 43, mesh));
+  file.close();
+  std::remove("model.mesh");
+}
+
+TEST_F(TriangleTest, RejectsMeshCacheGivenEmptyModel) {
+  vka::write_mesh_cache("model.mesh", 42, vka::Model());
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("model.mesh"));
+  vka::MeshView mesh;
+  EXPECT_FALSE(vka::read_mesh_cache(file, 42, mesh));
+  file.close();
+  std::remove("model.mesh");
+}
+
 TEST_F(TriangleTest, CreatesInstanceWithoutThrowingException) {
   std::vector<const char *> required_extensions_names = {
       VK_KHR_SURFACE_EXTENSION_NAME};
@@ -601,6 +923,45 @@ TEST_F(TriangleTest, CreatesDebugReportCallbackWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_debug_report_callback(instance(), nullptr));
 }
 
+TEST_F(TriangleTest, SelectsLayerNamesGivenLayersAreAvailable) {
+  vk::LayerProperties layer;
+  std::strcpy(layer.layerName, "VK_LAYER_LUNARG_standard_validation");
+  const std::vector<const char *> layer_names =
+      vka::select_available_layer_names(
+          {"VK_LAYER_LUNARG_standard_validation"}, {layer});
+  EXPECT_EQ(layer_names.size(), 1);
+}
+
+TEST_F(TriangleTest, SkipsLayerNamesGivenLayersAreNotAvailable) {
+  vk::LayerProperties layer;
+  std::strcpy(layer.layerName, "VK_LAYER_LUNARG_api_dump");
+  const std::vector<const char *> layer_names =
+      vka::select_available_layer_names(
+          {"VK_LAYER_LUNARG_standard_validation"}, {layer});
+  EXPECT_TRUE(layer_names.empty());
+}
+
+TEST_F(TriangleTest, SelectsExtensionNamesGivenExtensionsAreAvailable) {
+  vk::ExtensionProperties extension;
+  std::strcpy(extension.extensionName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+  const std::vector<const char *> extension_names =
+      vka::select_available_extension_names(
+          {VK_EXT_DEBUG_REPORT_EXTENSION_NAME}, {extension});
+  EXPECT_EQ(extension_names.size(), 1);
+}
+
+TEST_F(TriangleTest, SkipsExtensionNamesGivenExtensionsAreNotAvailable) {
+  const std::vector<const char *> extension_names =
+      vka::select_available_extension_names(
+          {VK_EXT_DEBUG_REPORT_EXTENSION_NAME}, {});
+  EXPECT_TRUE(extension_names.empty());
+}
+
+TEST_F(TriangleTest, ThrowsExceptionGivenPixelsAreReadWithoutOffscreenImages) {
+  vka::VulkanController controller;
+  EXPECT_THROW(controller.read_pixels(), std::runtime_error);
+}
+
 TEST_F(TriangleTest, SelectsNonEmptyPhysicalDeviceIfAnyIsAvailable) {
   std::vector<vk::PhysicalDevice> devices =
       instance().enumeratePhysicalDevices();
@@ -640,13 +1001,57 @@ TEST_F(TriangleTest, CreatesLogicalDeviceWithoutThrowingException) {
   const std::vector<vk::QueueFamilyProperties> queues =
       physical_device.getQueueFamilyProperties();
   const uint32_t queue_index = 0;
-  EXPECT_NO_THROW(vka::create_device(physical_device, queue_index));
+  EXPECT_NO_THROW(vka::create_device(physical_device, queue_index,
+                                     {VK_KHR_SWAPCHAIN_EXTENSION_NAME}));
+}
+
+TEST_F(TriangleTest,
+       CreatesLogicalDeviceWithoutExtensionsWithoutThrowingException) {
+  const uint32_t queue_index =
+      vka::find_graphics_queue_family_index(queue_family_properties());
+  EXPECT_NO_THROW(vka::create_device(physical_device(), queue_index, {}));
 }
 
 TEST_F(TriangleTest, CreatesCommandPoolWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_command_pool(device(), queue_index()));
 }
 
+TEST_F(TriangleTest, CreatesFenceWithoutThrowingException) {
+  EXPECT_NO_THROW(vka::create_fence(device(), false));
+}
+
+TEST_F(TriangleTest, CreatesSignaledFenceGivenIsSignaledIsTrue) {
+  vk::UniqueFence fence = vka::create_fence(device(), true);
+  EXPECT_EQ(device().getFenceStatus(*fence), vk::Result::eSuccess);
+}
+
+TEST_F(TriangleTest, CreatesSemaphoreWithoutThrowingException) {
+  EXPECT_NO_THROW(vka::create_semaphore(device()));
+}
+
+TEST_F(TriangleTest, CreatesTimestampQueryPoolWithoutThrowingException) {
+  EXPECT_NO_THROW(vka::create_timestamp_query_pool(device(), 2));
+}
+
+TEST_F(TriangleTest, CreatesStatisticsQueryPoolWithoutThrowingException) {
+  if (!physical_device().getFeatures().pipelineStatisticsQuery) {
+    return;
+  }
+  EXPECT_NO_THROW(vka::create_pipeline_statistics_query_pool(device(), 2));
+}
+
+TEST_F(TriangleTest, ReturnsTimestampMillisecondsGivenTimestampPeriod) {
+  EXPECT_DOUBLE_EQ(vka::get_timestamp_milliseconds(1000, 3000, 1.0f, 64),
+                   0.002);
+  EXPECT_DOUBLE_EQ(vka::get_timestamp_milliseconds(0, 1000000, 2.5f, 64), 2.5);
+}
+
+TEST_F(TriangleTest, ReturnsTimestampMillisecondsGivenWrappedTimestamp) {
+  EXPECT_DOUBLE_EQ(
+      vka::get_timestamp_milliseconds(0xFFFFFFF0, 0x10, 1000000.0f, 32),
+      32.0);
+}
+
 TEST_F(TriangleTest, CreatesVertexBufferWithoutThrowingException) {
   const uint32_t size =
       static_cast<uint32_t>(sizeof(vertices()[0]) * vertices().size());
@@ -749,6 +1154,57 @@ TEST_F(TriangleTest, FillsBufferWithObjectWithoutThrowingException) {
                                    uniform_buffer_object()));
 }
 
+TEST_F(TriangleTest, AlignsSizeToNextMultipleOfAlignment) {
+  EXPECT_EQ(vka::align_size(200, 256), 256u);
+}
+
+TEST_F(TriangleTest, ReturnsSameSizeGivenAlignmentIs0) {
+  EXPECT_EQ(vka::align_size(200, 0), 200u);
+}
+
+TEST_F(TriangleTest, AllocatesAlignedRangeFromFreeRanges) {
+  std::map<vk::DeviceSize, vk::DeviceSize> free_ranges = {{10, 1000}};
+  vk::DeviceSize offset = 0;
+  EXPECT_TRUE(vka::allocate_range(free_ranges, 100, 64, offset));
+  EXPECT_EQ(offset, 64u);
+  EXPECT_EQ(free_ranges[10], 54u);
+  EXPECT_EQ(free_ranges[164], 846u);
+}
+
+TEST_F(TriangleTest, DoesNotAllocateRangeGivenThereIsNoSpace) {
+  std::map<vk::DeviceSize, vk::DeviceSize> free_ranges = {{0, 64}};
+  vk::DeviceSize offset = 0;
+  EXPECT_FALSE(vka::allocate_range(free_ranges, 128, 1, offset));
+}
+
+TEST_F(TriangleTest, MergesFreedRangeWithNeighbours) {
+  std::map<vk::DeviceSize, vk::DeviceSize> free_ranges = {{0, 64},
+                                                          {128, 64}};
+  vka::free_range(free_ranges, 64, 64);
+  ASSERT_EQ(free_ranges.size(), 1u);
+  EXPECT_EQ(free_ranges[0], 192u);
+}
+
+TEST_F(TriangleTest, CreatesUniformRingBufferWithAlignedSlices) {
+  const vk::DeviceSize alignment =
+      physical_device().getProperties().limits.minUniformBufferOffsetAlignment;
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  vka::UniformRingBuffer ring_buffer = vka::create_uniform_ring_buffer(
+      device(), allocator, alignment, sizeof(vka::UniformBufferObject), 2, 3);
+  EXPECT_NE(ring_buffer.data, nullptr);
+  EXPECT_EQ(ring_buffer.slice_size % alignment, 0u);
+  EXPECT_GE(ring_buffer.slice_size, sizeof(vka::UniformBufferObject));
+  allocator.free(ring_buffer.memory);
+}
+
+TEST_F(TriangleTest, ReturnsUniformSliceOffsetOfFrameAndSlice) {
+  vka::UniformRingBuffer ring_buffer;
+  ring_buffer.slice_size = 256;
+  ring_buffer.slices_per_frame = 4;
+  EXPECT_EQ(vka::get_uniform_slice_offset(ring_buffer, 1, 2), 1536u);
+}
+
 TEST_F(TriangleTest, BeginsCommandWithoutThrowingException) {
   EXPECT_NO_THROW(vka::begin_command(device(), command_pool()));
 }
@@ -775,6 +1231,11 @@ TEST_F(TriangleTest, CreatesCommandBuffersWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_command_buffers(device(), command_pool(), 3));
 }
 
+TEST_F(TriangleTest, CreatesSecondaryCommandBuffersWithoutThrowingException) {
+  EXPECT_NO_THROW(
+      vka::create_secondary_command_buffers(device(), command_pool(), 3));
+}
+
 TEST_F(TriangleTest,
        ReturnsVectorWithPresentationSupportForEachAvailableQueueFamily) {
   std::vector<vk::Bool32> presentation_support = vka::get_presentation_support(
@@ -918,6 +1379,21 @@ TEST_F(TriangleTest,
   EXPECT_EQ(vk::Extent2D(width, height), vk::Extent2D(old_width, old_height));
 }
 
+TEST_F(TriangleTest, SelectsRequestedPresentModeGivenItIsSupported) {
+  std::vector<vk::PresentModeKHR> present_modes = {
+      vk::PresentModeKHR::eFifo, vk::PresentModeKHR::eMailbox};
+  EXPECT_EQ(
+      vka::select_present_mode(present_modes, vk::PresentModeKHR::eMailbox),
+      vk::PresentModeKHR::eMailbox);
+}
+
+TEST_F(TriangleTest, SelectsFifoPresentModeGivenRequestedIsNotSupported) {
+  std::vector<vk::PresentModeKHR> present_modes = {vk::PresentModeKHR::eFifo};
+  EXPECT_EQ(
+      vka::select_present_mode(present_modes, vk::PresentModeKHR::eImmediate),
+      vk::PresentModeKHR::eFifo);
+}
+
 TEST_F(TriangleTest, CreatesSwapchainWithoutThrowingException) {
   WindowManager window_manager;
   vk::UniqueSurfaceKHR surface =
@@ -934,14 +1410,15 @@ TEST_F(TriangleTest, CreatesSwapchainWithoutThrowingException) {
   const vk::Extent2D extent =
       vka::select_swapchain_extent(capabilities, width, height);
   EXPECT_NO_THROW(vka::create_swapchain(format, extent, capabilities, device(),
-                                        *surface, nullptr));
+                                        *surface, nullptr,
+                                        vk::PresentModeKHR::eFifo));
   surface.release();
 }
 
 TEST_F(TriangleTest, CreatesImageViewWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_image_view(device(), swapchain_images()[0],
                                          surface_format().format,
-                                         vk::ImageAspectFlagBits::eColor));
+                                         vk::ImageAspectFlagBits::eColor, 1));
 }
 
 TEST_F(TriangleTest, CreatesSwapchainImageViewsWithoutThrowingException) {
@@ -969,17 +1446,76 @@ TEST_F(TriangleTest, CreatesShaderModuleWithoutThrowingException) {
 }
 
 TEST_F(TriangleTest, CreatesPipelineLayoutWithoutThrowingException) {
-  EXPECT_NO_THROW(
-      vka::create_pipeline_layout(device(), descriptor_set_layout()));
+  EXPECT_NO_THROW(vka::create_pipeline_layout(
+      device(), descriptor_set_layout(), vka::TransformMode::uniform_buffer));
+}
+
+TEST_F(TriangleTest, CreatesPipelineLayoutGivenPushConstantTransform) {
+  EXPECT_NO_THROW(vka::create_pipeline_layout(
+      device(), descriptor_set_layout(), vka::TransformMode::push_constants));
 }
 
 TEST_F(TriangleTest, CreatesRenderPassWithoutThrowingException) {
+  EXPECT_NO_THROW(vka::create_render_pass(device(), vk::Format::eB8G8R8A8Unorm,
+                                          vk::ImageLayout::ePresentSrcKHR));
+}
+
+TEST_F(TriangleTest, CreatesOffscreenRenderPassWithoutThrowingException) {
   EXPECT_NO_THROW(
-      vka::create_render_pass(device(), vk::Format::eB8G8R8A8Unorm));
+      vka::create_render_pass(device(), vk::Format::eR8G8B8A8Unorm,
+                              vk::ImageLayout::eTransferSrcOptimal));
 }
 
 TEST_F(TriangleTest, CreatesDescriptorPoolWithoutThrowingException) {
-  EXPECT_NO_THROW(vka::create_descriptor_pool(device()));
+  EXPECT_NO_THROW(vka::create_descriptor_pool(device(), 1));
+}
+
+TEST_F(TriangleTest,
+       CreatesDescriptorPoolForMultipleSetsWithoutThrowingException) {
+  const vk::UniqueDescriptorPool descriptor_pool =
+      vka::create_descriptor_pool(device(), 3);
+  for (uint32_t i = 0; i < 3; ++i) {
+    EXPECT_NO_THROW(vka::create_descriptor_sets(device(), *descriptor_pool,
+                                                descriptor_set_layout()));
+  }
+}
+
+TEST_F(TriangleTest, CreatesResetOnlyDescriptorPoolGivenSetSizes) {
+  const vk::UniqueDescriptorPool descriptor_pool = vka::create_descriptor_pool(
+      device(), vka::get_descriptor_set_sizes(), 2,
+      vk::DescriptorPoolCreateFlags());
+  vk::DescriptorSetLayout layouts[] = {descriptor_set_layout(),
+                                       descriptor_set_layout()};
+  vk::DescriptorSetAllocateInfo info;
+  info.descriptorPool = *descriptor_pool;
+  info.descriptorSetCount = 2;
+  info.pSetLayouts = layouts;
+  EXPECT_EQ(device().allocateDescriptorSets(info).size(), 2);
+  EXPECT_NO_THROW(device().resetDescriptorPool(
+      *descriptor_pool, vk::DescriptorPoolResetFlags()));
+}
+
+TEST_F(TriangleTest, AllocatesDescriptorSetsAcrossMultiplePools) {
+  vka::DescriptorAllocator descriptor_allocator;
+  descriptor_allocator.initialize(device(), vka::get_descriptor_set_sizes(), 2,
+                                  2);
+  descriptor_allocator.begin_frame(0);
+  EXPECT_EQ(descriptor_allocator.allocate(descriptor_set_layout(), 5).size(),
+            5);
+  EXPECT_EQ(descriptor_allocator.get_pool_count(), 3);
+  descriptor_allocator.release();
+}
+
+TEST_F(TriangleTest, RecyclesDescriptorPoolsGivenFrameIsReused) {
+  vka::DescriptorAllocator descriptor_allocator;
+  descriptor_allocator.initialize(device(), vka::get_descriptor_set_sizes(), 2,
+                                  2);
+  for (uint32_t i = 0; i < 4; ++i) {
+    descriptor_allocator.begin_frame(i % 2);
+    descriptor_allocator.allocate(descriptor_set_layout(), 3);
+  }
+  EXPECT_EQ(descriptor_allocator.get_pool_count(), 4);
+  descriptor_allocator.release();
 }
 
 TEST_F(TriangleTest, CreatesDescriptorSetLayoutWithoutThrowingException) {
@@ -1001,7 +1537,51 @@ TEST_F(TriangleTest, UpdatesDescriptorSetsWithoutThrowingException) {
 
 TEST_F(TriangleTest, CreatesGraphicsPipelineWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_graphics_pipeline(
-      device(), render_pass(), swapchain_extent(), pipeline_layout()));
+      device(), render_pass(), pipeline_layout(), vk::PipelineCache(),
+      vka::VertexLayout::full, vka::TransformMode::uniform_buffer));
+}
+
+TEST_F(TriangleTest, CreatesGraphicsPipelineGivenPushConstantTransform) {
+  const vk::UniquePipelineLayout pipeline_layout = vka::create_pipeline_layout(
+      device(), descriptor_set_layout(), vka::TransformMode::push_constants);
+  EXPECT_NO_THROW(vka::create_graphics_pipeline(
+      device(), render_pass(), *pipeline_layout, vk::PipelineCache(),
+      vka::VertexLayout::full, vka::TransformMode::push_constants));
+}
+
+TEST_F(TriangleTest, CreatesGraphicsPipelineGivenQuantizedVertexLayout) {
+  EXPECT_NO_THROW(vka::create_graphics_pipeline(
+      device(), render_pass(), pipeline_layout(), vk::PipelineCache(),
+      vka::VertexLayout::quantized, vka::TransformMode::uniform_buffer));
+}
+
+TEST_F(TriangleTest, CreatesGraphicsPipelineWithPipelineCache) {
+  vk::UniquePipelineCache pipeline_cache =
+      vka::create_pipeline_cache(device(), {});
+  EXPECT_NO_THROW(vka::create_graphics_pipeline(
+      device(), render_pass(), pipeline_layout(), *pipeline_cache,
+      vka::VertexLayout::full, vka::TransformMode::uniform_buffer));
+  EXPECT_TRUE(vka::is_pipeline_cache_valid(
+      vka::get_pipeline_cache_data(device(), *pipeline_cache),
+      physical_device().getProperties()));
+}
+
+TEST_F(TriangleTest, ReturnsPipelineCacheIsInvalidGivenItIsEmpty) {
+  EXPECT_FALSE(
+      vka::is_pipeline_cache_valid({}, vk::PhysicalDeviceProperties()));
+}
+
+TEST_F(TriangleTest, ReturnsPipelineCacheIsInvalidGivenDifferentDevice) {
+  vk::PhysicalDeviceProperties properties = physical_device().getProperties();
+  vk::UniquePipelineCache pipeline_cache =
+      vka::create_pipeline_cache(device(), {});
+  vka::create_graphics_pipeline(device(), render_pass(), pipeline_layout(),
+                                *pipeline_cache, vka::VertexLayout::full,
+                                vka::TransformMode::uniform_buffer);
+  const std::vector<char> data =
+      vka::get_pipeline_cache_data(device(), *pipeline_cache);
+  properties.deviceID += 1;
+  EXPECT_FALSE(vka::is_pipeline_cache_valid(data, properties));
 }
 
 TEST_F(TriangleTest, CreatesFramebuffersWithoutThrowingException) {
@@ -1013,16 +1593,114 @@ TEST_F(TriangleTest, CreatesFramebuffersWithoutThrowingException) {
 
 TEST_F(TriangleTest, RecordsCommandBuffersWithoutThrowingException) {
   vertex_buffer_memory();
+  instance_buffer_memory();
+  index_buffer_memory();
+  uniform_buffer_memory();
+  texture_image_memory();
+  depth_image_memory();
+  vka::update_descriptor_sets(device(), descriptor_sets(), uniform_buffer(),
+                              texture_image_view(), texture_sampler());
+  EXPECT_NO_THROW(vka::record_command_buffers(
+      device(), command_buffers(), render_pass(), graphics_pipeline(),
+      pipeline_layout(), framebuffers(), swapchain_extent(), vertex_buffer(),
+      instance_buffer(), index_buffer(), vk::IndexType::eUint32,
+      {{0, static_cast<uint32_t>(indices().size()), 0}}, descriptor_sets(),
+      {{0, 1, 0}}, vka::TransformMode::uniform_buffer, {}, vk::QueryPool(), 0,
+      vk::QueryPool(), 0));
+}
+
+TEST_F(TriangleTest, RecordsCommandBuffersGivenPushConstantTransform) {
+  vertex_buffer_memory();
+  instance_buffer_memory();
+  index_buffer_memory();
+  uniform_buffer_memory();
+  texture_image_memory();
+  depth_image_memory();
+  vka::update_descriptor_sets(device(), descriptor_sets(), uniform_buffer(),
+                              texture_image_view(), texture_sampler());
+  const vk::UniquePipelineLayout pipeline_layout = vka::create_pipeline_layout(
+      device(), descriptor_set_layout(), vka::TransformMode::push_constants);
+  const vk::UniquePipeline graphics_pipeline = vka::create_graphics_pipeline(
+      device(), render_pass(), *pipeline_layout, vk::PipelineCache(),
+      vka::VertexLayout::full, vka::TransformMode::push_constants);
+  EXPECT_NO_THROW(vka::record_command_buffers(
+      device(), command_buffers(), render_pass(), *graphics_pipeline,
+      *pipeline_layout, framebuffers(), swapchain_extent(), vertex_buffer(),
+      instance_buffer(), index_buffer(), vk::IndexType::eUint32,
+      {{0, static_cast<uint32_t>(indices().size()), 0}}, descriptor_sets(),
+      {{0, 1, 0}, {0, 1, 0}}, vka::TransformMode::push_constants,
+      {glm::mat4(1.0f), glm::mat4(2.0f)}, vk::QueryPool(), 0, vk::QueryPool(),
+      0));
+}
+
+TEST_F(TriangleTest, RecordsTimestampedCommandBuffersWithoutThrowingException) {
+  vertex_buffer_memory();
+  instance_buffer_memory();
+  index_buffer_memory();
+  uniform_buffer_memory();
+  texture_image_memory();
+  depth_image_memory();
+  vka::update_descriptor_sets(device(), descriptor_sets(), uniform_buffer(),
+                              texture_image_view(), texture_sampler());
+  vk::UniqueQueryPool query_pool = vka::create_timestamp_query_pool(
+      device(), static_cast<uint32_t>(2 * command_buffers().size()));
+  EXPECT_NO_THROW(vka::record_command_buffers(
+      device(), command_buffers(), render_pass(), graphics_pipeline(),
+      pipeline_layout(), framebuffers(), swapchain_extent(), vertex_buffer(),
+      instance_buffer(), index_buffer(), vk::IndexType::eUint32,
+      {{0, static_cast<uint32_t>(indices().size()), 0}}, descriptor_sets(),
+      {{0, 1, 0}}, vka::TransformMode::uniform_buffer, {}, *query_pool, 0,
+      vk::QueryPool(), 0));
+}
+
+TEST_F(TriangleTest, RecordsPipelineStatisticsWithoutThrowingException) {
+  if (!physical_device().getFeatures().pipelineStatisticsQuery) {
+    return;
+  }
+  vertex_buffer_memory();
+  instance_buffer_memory();
   index_buffer_memory();
   uniform_buffer_memory();
   texture_image_memory();
   depth_image_memory();
   vka::update_descriptor_sets(device(), descriptor_sets(), uniform_buffer(),
                               texture_image_view(), texture_sampler());
+  vk::UniqueQueryPool query_pool = vka::create_pipeline_statistics_query_pool(
+      device(), static_cast<uint32_t>(command_buffers().size()));
   EXPECT_NO_THROW(vka::record_command_buffers(
       device(), command_buffers(), render_pass(), graphics_pipeline(),
       pipeline_layout(), framebuffers(), swapchain_extent(), vertex_buffer(),
-      index_buffer(), indices(), descriptor_sets()));
+      instance_buffer(), index_buffer(), vk::IndexType::eUint32,
+      {{0, static_cast<uint32_t>(indices().size()), 0}}, descriptor_sets(),
+      {{0, 1, 0}}, vka::TransformMode::uniform_buffer, {}, vk::QueryPool(), 0,
+      *query_pool, 0));
+}
+
+TEST_F(TriangleTest, RecordsSecondaryCommandBuffersWithoutThrowingException) {
+  vertex_buffer_memory();
+  instance_buffer_memory();
+  index_buffer_memory();
+  uniform_buffer_memory();
+  texture_image_memory();
+  depth_image_memory();
+  vka::update_descriptor_sets(device(), descriptor_sets(), uniform_buffer(),
+                              texture_image_view(), texture_sampler());
+  std::vector<vk::UniqueCommandBuffer> secondary_command_buffers =
+      vka::create_secondary_command_buffers(device(), command_pool(), 2);
+  for (const auto &command_buffer : secondary_command_buffers) {
+    EXPECT_NO_THROW(vka::record_secondary_command_buffer(
+        *command_buffer, render_pass(), framebuffers()[0], graphics_pipeline(),
+        pipeline_layout(), swapchain_extent(), vertex_buffer(),
+        instance_buffer(), index_buffer(), vk::IndexType::eUint32,
+        {{0, static_cast<uint32_t>(indices().size()), 0}}, descriptor_sets(),
+        {{0, 1, 0}}, vka::TransformMode::uniform_buffer, {},
+        vk::QueryPipelineStatisticFlags()));
+  }
+  EXPECT_NO_THROW(vka::record_primary_command_buffer(
+      command_buffers()[0], render_pass(), framebuffers()[0],
+      swapchain_extent(),
+      {*secondary_command_buffers[0], *secondary_command_buffers[1]},
+      vk::QueryPool(), 0, vk::QueryPool(), 0));
 }
 
 TEST_F(TriangleTest, DrawsFrameWithoutThrowingException) {
@@ -1032,6 +1710,7 @@ TEST_F(TriangleTest, DrawsFrameWithoutThrowingException) {
   vka::fill_buffer(device(), staging_vertex_buffer_memory(), vertices());
   vka::copy_buffer_to_buffer(device(), staging_vertex_buffer(), vertex_buffer(),
                              vertices_size, command_pool(), queue_index());
+  instance_buffer_memory();
   index_buffer_memory();
   const uint32_t indices_size =
       static_cast<uint32_t>(sizeof(indices()[0]) * indices().size());
@@ -1053,21 +1732,24 @@ TEST_F(TriangleTest, DrawsFrameWithoutThrowingException) {
   vka::record_command_buffers(
       device(), command_buffer_pointers, render_pass(), graphics_pipeline(),
       pipeline_layout(), framebuffers(), swapchain_extent(), vertex_buffer(),
-      index_buffer(), indices(), descriptor_sets());
-  vk::SemaphoreCreateInfo semaphore_info;
-  vk::UniqueSemaphore is_image_available =
-      device().createSemaphoreUnique(semaphore_info);
-  vk::UniqueSemaphore is_rendering_finished =
-      device().createSemaphoreUnique(semaphore_info);
+      instance_buffer(), index_buffer(), vk::IndexType::eUint32,
+      {{0, static_cast<uint32_t>(indices().size()), 0}}, descriptor_sets(),
+      {{0, 1, 0}}, vka::TransformMode::uniform_buffer, {}, vk::QueryPool(), 0,
+      vk::QueryPool(), 0);
+  vk::UniqueSemaphore is_image_available = vka::create_semaphore(device());
+  vk::UniqueSemaphore is_rendering_finished = vka::create_semaphore(device());
+  vk::UniqueFence is_frame_finished = vka::create_fence(device(), false);
   EXPECT_NO_THROW(vka::draw_frame(device(), swapchain(), *is_image_available,
-                                  *is_rendering_finished,
+                                  *is_rendering_finished, *is_frame_finished,
                                   command_buffer_pointers, queue_index()));
+  device().waitForFences(*is_frame_finished, VK_TRUE, UINT64_MAX);
 }
 
 TEST_F(TriangleTest, CreatesImageWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_image(
       device(), 32, 64, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal,
-      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled));
+      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+      1));
 }
 
 TEST_F(TriangleTest, AllocatesMemoryForImageWithoutThrowingException) {
@@ -1076,12 +1758,214 @@ TEST_F(TriangleTest, AllocatesMemoryForImageWithoutThrowingException) {
       vk::MemoryPropertyFlagBits::eDeviceLocal));
 }
 
+TEST_F(TriangleTest, SubAllocatesBufferMemoryFromSingleBlock) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  const vka::MemoryAllocation first = vka::allocate_buffer_memory(
+      device(), staging_vertex_buffer(), allocator,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "first");
+  const vka::MemoryAllocation second = vka::allocate_buffer_memory(
+      device(), staging_vertex_buffer(), allocator,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "second");
+  EXPECT_EQ(first.memory, second.memory);
+  EXPECT_GE(second.offset, first.offset + first.size);
+  EXPECT_NE(second.data, nullptr);
+}
+
+TEST_F(TriangleTest, SubAllocatesImageMemoryWithoutThrowingException) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  EXPECT_NO_THROW(vka::allocate_image_memory(
+      device(), texture_image(), allocator,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageTiling::eOptimal,
+      "texture_image"));
+}
+
+TEST_F(TriangleTest, ReportsHeapStatisticsOfAllocations) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  vka::MemoryAllocation allocation = vka::allocate_buffer_memory(
+      device(), staging_vertex_buffer(), allocator,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "staging_buffer");
+  const uint32_t heap_index =
+      physical_device()
+          .getMemoryProperties()
+          .memoryTypes[allocation.block->memory_type_index]
+          .heapIndex;
+  vka::MemoryHeapStatistics heap =
+      allocator.get_heap_statistics()[heap_index];
+  EXPECT_EQ(heap.block_count, 1u);
+  EXPECT_EQ(heap.allocation_count, 1u);
+  EXPECT_EQ(heap.used_size, allocation.size);
+
+  const vk::DeviceSize allocation_size = allocation.size;
+  allocator.free(allocation);
+  heap = allocator.get_heap_statistics()[heap_index];
+  EXPECT_EQ(heap.allocation_count, 0u);
+  EXPECT_EQ(heap.used_size, 0u);
+  EXPECT_EQ(heap.peak_used_size, allocation_size);
+  EXPECT_EQ(heap.free_range_count, 1u);
+}
+
+TEST_F(TriangleTest, ReleasesOversizedBlockGivenItsLastAllocationIsFreed) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 16);
+  vka::MemoryAllocation allocation = vka::allocate_buffer_memory(
+      device(), staging_vertex_buffer(), allocator,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "staging_buffer");
+  const uint32_t heap_index =
+      physical_device()
+          .getMemoryProperties()
+          .memoryTypes[allocation.block->memory_type_index]
+          .heapIndex;
+  allocator.free(allocation);
+  EXPECT_EQ(allocator.get_heap_statistics()[heap_index].block_count, 0u);
+}
+
+TEST_F(TriangleTest, ReportsResourceStatisticsOfNamedAllocations) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  const vk::MemoryPropertyFlags properties =
+      vk::MemoryPropertyFlagBits::eHostVisible |
+      vk::MemoryPropertyFlagBits::eHostCoherent;
+  vka::MemoryAllocation first = vka::allocate_buffer_memory(
+      device(), staging_vertex_buffer(), allocator, properties, "vertices");
+  vka::MemoryAllocation second = vka::allocate_buffer_memory(
+      device(), staging_vertex_buffer(), allocator, properties, "vertices");
+  allocator.free(first);
+
+  const std::vector<vka::MemoryResourceStatistics> resources =
+      allocator.get_resource_statistics();
+  ASSERT_EQ(resources.size(), 1u);
+  EXPECT_EQ(resources[0].name, "vertices");
+  EXPECT_EQ(resources[0].memory_type_index, second.block->memory_type_index);
+  EXPECT_EQ(resources[0].live_size, second.size);
+  EXPECT_EQ(resources[0].peak_size, 2 * second.size);
+  EXPECT_EQ(resources[0].live_count, 1u);
+  EXPECT_EQ(resources[0].allocation_count, 2u);
+  allocator.free(second);
+}
+
+TEST_F(TriangleTest, ReturnsMemoryReportWithResourceNames) {
+  vka::MemoryHeapStatistics heap = {};
+  heap.heap_size = 1024;
+  vka::MemoryResourceStatistics resource = {};
+  resource.name = "depth_image";
+  const std::string report = vka::format_memory_report({heap}, {resource});
+  EXPECT_NE(report.find("heap 0"), std::string::npos);
+  EXPECT_NE(report.find("depth_image"), std::string::npos);
+}
+
+TEST_F(TriangleTest, ReturnsTrueGivenAvailableExtension) {
+  vk::ExtensionProperties extension;
+  std::strcpy(extension.extensionName, "VK_EXT_memory_budget");
+  EXPECT_TRUE(vka::is_extension_available({extension}, "VK_EXT_memory_budget"));
+  EXPECT_FALSE(vka::is_extension_available({extension}, "VK_KHR_swapchain"));
+}
+
 TEST_F(TriangleTest, TransitionsImageLayoutWithoutThrowingException) {
   EXPECT_NO_THROW(vka::transition_image_layout(
       device(), command_pool(), queue_index(), vk::ImageLayout::eUndefined,
       vk::ImageLayout::eTransferDstOptimal, texture_image()));
 }
 
+TEST_F(TriangleTest, UploadsBufferWithinSingleSubmission) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  vka::UploadContext upload_context;
+  upload_context.initialize(device(), queue_index(), allocator);
+  vertex_buffer_memory();
+  index_buffer_memory();
+  upload_context.upload_buffer(
+      vertices().data(),
+      static_cast<uint32_t>(sizeof(vertices()[0]) * vertices().size()),
+      vertex_buffer());
+  upload_context.upload_buffer(
+      indices().data(),
+      static_cast<uint32_t>(sizeof(indices()[0]) * indices().size()),
+      index_buffer());
+  upload_context.submit();
+  upload_context.wait();
+  EXPECT_TRUE(upload_context.poll());
+}
+
+TEST_F(TriangleTest, UploadsImageWithoutThrowingException) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  vka::UploadContext upload_context;
+  upload_context.initialize(device(), queue_index(), allocator);
+  texture_image_memory();
+  const std::vector<vka::ImageLevel> levels = {
+      {texture().data.get(), static_cast<uint32_t>(texture().size),
+       texture().width, texture().height}};
+  EXPECT_NO_THROW(upload_context.upload_image(levels, texture_image(), 1));
+  upload_context.submit();
+  upload_context.wait();
+}
+
+TEST_F(TriangleTest, GeneratesMipmapsWithoutThrowingException) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 16 * 1024 * 1024);
+  vka::UploadContext upload_context;
+  upload_context.initialize(device(), queue_index(), allocator);
+  const uint32_t mip_level_count =
+      vka::get_mip_level_count(texture().width, texture().height);
+  const vk::UniqueImage image = vka::create_image(
+      device(), texture().width, texture().height, vk::Format::eR8G8B8A8Unorm,
+      vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eTransferSrc |
+          vk::ImageUsageFlagBits::eTransferDst |
+          vk::ImageUsageFlagBits::eSampled,
+      mip_level_count);
+  vka::MemoryAllocation memory = vka::allocate_image_memory(
+      device(), *image, allocator, vk::MemoryPropertyFlagBits::eDeviceLocal,
+      vk::ImageTiling::eOptimal, "image");
+  device().bindImageMemory(*image, memory.memory, memory.offset);
+  const std::vector<vka::ImageLevel> levels = {
+      {texture().data.get(), static_cast<uint32_t>(texture().size),
+       texture().width, texture().height}};
+  EXPECT_NO_THROW(upload_context.upload_image(levels, *image, mip_level_count));
+  upload_context.submit();
+  upload_context.wait();
+}
+
+TEST_F(TriangleTest, RetiresEarlierUploadGivenItsTimestampQueryIsReused) {
+  if (physical_device()
+          .getQueueFamilyProperties()[queue_index()]
+          .timestampValidBits == 0) {
+    return;
+  }
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  vka::UploadContext upload_context;
+  upload_context.initialize(device(), queue_index(), allocator);
+  vk::UniqueQueryPool query_pool =
+      vka::create_timestamp_query_pool(device(), 2);
+  upload_context.set_timestamp_queries(*query_pool, 0, 2, 1.0f, 64);
+  upload_context.get_command_buffer();
+  upload_context.submit();
+  upload_context.get_command_buffer();
+  EXPECT_TRUE(upload_context.poll());
+  upload_context.submit();
+  upload_context.wait();
+}
+
+TEST_F(TriangleTest, PollsUploadsAsFinishedGivenNothingWasSubmitted) {
+  vka::MemoryAllocator allocator;
+  allocator.initialize(device(), physical_device(), 1024 * 1024);
+  vka::UploadContext upload_context;
+  upload_context.initialize(device(), queue_index(), allocator);
+  EXPECT_TRUE(upload_context.poll());
+}
+
 TEST_F(TriangleTest, CopiesBufferToImageWithoutThrowingException) {
   staging_texture_buffer_memory();
   vka::fill_buffer(device(), staging_texture_buffer_memory(), texture());
@@ -1096,9 +1980,382 @@ TEST_F(TriangleTest, CopiesBufferToImageWithoutThrowingException) {
 
 TEST_F(TriangleTest, CreatesTextureImageViewWithoutThrowingException) {
   texture_image_memory();
-  EXPECT_NO_THROW(vka::create_texture_image_view(device(), texture_image()));
+  EXPECT_NO_THROW(vka::create_texture_image_view(
+      device(), texture_image(), vk::Format::eR8G8B8A8Unorm, 1));
 }
 
 TEST_F(TriangleTest, CreatesTextureSamplerWithoutThrowingException) {
   EXPECT_NO_THROW(vka::create_texture_sampler(device()));
 }
+
+TEST_F(TriangleTest, ReturnsIdentityGivenSingleInstance) {
+  const std::vector<vka::InstanceData> instances = vka::get_instance_grid(1);
+  ASSERT_EQ(instances.size(), 1u);
+  EXPECT_EQ(instances[0].model, glm::mat4(1.0f));
+}
+
+TEST_F(TriangleTest, PlacesInstancesInsideUnitSquareGivenInstanceGrid) {
+  const std::vector<vka::InstanceData> instances = vka::get_instance_grid(10);
+  ASSERT_EQ(instances.size(), 10u);
+  for (const auto &instance : instances) {
+    const glm::vec4 position = instance.model * glm::vec4(0, 0, 0, 1);
+    EXPECT_GT(position.x, -1.0f);
+    EXPECT_LT(position.x, 1.0f);
+    EXPECT_GT(position.y, -1.0f);
+    EXPECT_LT(position.y, 1.0f);
+  }
+  EXPECT_NE(instances[0].model, instances[1].model);
+}
+
+TEST_F(TriangleTest, ThrowsExceptionGivenZeroInstances) {
+  EXPECT_THROW(vka::get_instance_grid(0), std::runtime_error);
+}
+
+TEST_F(TriangleTest, EnclosesAllVerticesGivenBoundingSphere) {
+  const vka::MeshView mesh = {vertices().data(),
+                              static_cast<uint32_t>(vertices().size()),
+                              indices().data(),
+                              static_cast<uint32_t>(indices().size())};
+  const vka::BoundingSphere bounds = vka::compute_bounding_sphere(mesh);
+  for (const auto &vertex : vertices()) {
+    EXPECT_LE(glm::distance(bounds.center, vertex.position),
+              bounds.radius + 1e-5f);
+  }
+}
+
+TEST_F(TriangleTest, ReturnsVisibleInstancesGivenFrustum) {
+  const glm::mat4 projection =
+      glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+  const vka::Frustum frustum = vka::extract_frustum(projection);
+  vka::InstanceBounds bounds;
+  bounds.x = {0.0f, 0.0f, 20.0f, 0.0f, 0.0f, -3.0f, 0.0f};
+  bounds.y = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  bounds.z = {-5.0f, 5.0f, -5.0f, -20.0f, -10.5f, -2.0f, -0.05f};
+  bounds.radius = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.5f, 0.01f};
+  std::vector<uint32_t> visible_instances;
+  vka::cull_instances(frustum, bounds, visible_instances);
+  EXPECT_EQ(visible_instances, std::vector<uint32_t>({0, 4, 5}));
+}
+
+TEST_F(TriangleTest, ReturnsSameInstancesGivenVectorAndScalarCulling) {
+  const glm::mat4 projection =
+      glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 10.0f);
+  const vka::Frustum frustum = vka::extract_frustum(projection);
+  const std::vector<vka::InstanceData> instances =
+      vka::get_instance_grid(1001);
+  const vka::BoundingSphere mesh_bounds = {glm::vec3(0.0f, 0.0f, -1.5f),
+                                           0.01f};
+  const vka::InstanceBounds bounds =
+      vka::get_instance_bounds(instances, mesh_bounds);
+  std::vector<uint32_t> expected_instances;
+  for (uint32_t i = 0; i < instances.size(); ++i) {
+    vka::InstanceBounds instance_bounds;
+    instance_bounds.x = {bounds.x[i]};
+    instance_bounds.y = {bounds.y[i]};
+    instance_bounds.z = {bounds.z[i]};
+    instance_bounds.radius = {bounds.radius[i]};
+    std::vector<uint32_t> visible_instances;
+    vka::cull_instances(frustum, instance_bounds, visible_instances);
+    if (!visible_instances.empty()) {
+      expected_instances.push_back(i);
+    }
+  }
+  std::vector<uint32_t> visible_instances;
+  vka::cull_instances(frustum, bounds, visible_instances);
+  EXPECT_EQ(visible_instances, expected_instances);
+  EXPECT_FALSE(visible_instances.empty());
+  EXPECT_LT(visible_instances.size(), instances.size());
+}
+
+TEST_F(TriangleTest, ReturnsInstanceRateBindingGivenBindingDescriptions) {
+  const std::vector<vk::VertexInputBindingDescription> descriptions =
+      vka::get_binding_descriptions(vka::VertexLayout::full);
+  ASSERT_EQ(descriptions.size(), 2u);
+  EXPECT_EQ(descriptions[1].inputRate, vk::VertexInputRate::eInstance);
+  EXPECT_EQ(descriptions[1].stride, sizeof(vka::InstanceData));
+}
+
+TEST_F(TriangleTest, ReturnsSmallerVertexSizeGivenCompactLayouts) {
+  EXPECT_EQ(vka::get_vertex_size(vka::VertexLayout::full), 32u);
+  EXPECT_EQ(vka::get_vertex_size(vka::VertexLayout::compact), 16u);
+  EXPECT_EQ(vka::get_vertex_size(vka::VertexLayout::quantized), 12u);
+}
+
+TEST_F(TriangleTest, ReturnsPushConstantVertexShaderGivenPushConstantMode) {
+  EXPECT_EQ(vka::get_vertex_shader_file_name(
+                vka::VertexLayout::full, vka::TransformMode::uniform_buffer),
+            "vert.spv");
+  EXPECT_EQ(vka::get_vertex_shader_file_name(
+                vka::VertexLayout::full, vka::TransformMode::push_constants),
+            "vert_push.spv");
+  EXPECT_EQ(vka::get_vertex_shader_file_name(
+                vka::VertexLayout::quantized,
+                vka::TransformMode::push_constants),
+            "vert_no_color_push.spv");
+}
+
+TEST_F(TriangleTest, SkipsColorAttributeGivenQuantizedLayout) {
+  const std::vector<vk::VertexInputAttributeDescription> descriptions =
+      vka::get_attribute_descriptions(vka::VertexLayout::quantized);
+  ASSERT_EQ(descriptions.size(), 6u);
+  EXPECT_EQ(descriptions[0].format, vk::Format::eR16G16B16A16Unorm);
+  EXPECT_EQ(descriptions[1].location, 2u);
+  EXPECT_EQ(descriptions[1].format, vk::Format::eR16G16Sfloat);
+  EXPECT_EQ(descriptions[2].location, 3u);
+}
+
+TEST_F(TriangleTest, ReturnsHalfFloatGivenFloat) {
+  EXPECT_EQ(vka::pack_half(0.0f), 0x0000);
+  EXPECT_EQ(vka::pack_half(1.0f), 0x3C00);
+  EXPECT_EQ(vka::pack_half(-2.0f), 0xC000);
+  EXPECT_EQ(vka::pack_half(0.333333f), 0x3555);
+  EXPECT_EQ(vka::pack_half(65504.0f), 0x7BFF);
+  EXPECT_EQ(vka::pack_half(1e6f), 0x7C00);
+  EXPECT_EQ(vka::pack_half(5.9604645e-8f), 0x0001);
+}
+
+TEST_F(TriangleTest, RestoresPositionsGivenQuantizedVertices) {
+  const vka::MeshView mesh = {vertices().data(),
+                              static_cast<uint32_t>(vertices().size()),
+                              nullptr,
+                              0,
+                              vk::IndexType::eUint32,
+                              nullptr,
+                              0};
+  const vka::BoundingBox bounds = vka::compute_bounding_box(mesh);
+  const std::vector<uint8_t> data =
+      vka::pack_vertices(mesh, vka::VertexLayout::quantized, bounds);
+  ASSERT_EQ(data.size(), vertices().size() * sizeof(vka::QuantizedVertex));
+  const vka::QuantizedVertex *quantized_vertices =
+      reinterpret_cast<const vka::QuantizedVertex *>(data.data());
+  const glm::mat4 dequantization =
+      vka::get_dequantization_matrix(vka::VertexLayout::quantized, bounds);
+  for (size_t i = 0; i < vertices().size(); ++i) {
+    const glm::vec4 position =
+        dequantization * glm::vec4(quantized_vertices[i].position[0] / 65535.0f,
+                                   quantized_vertices[i].position[1] / 65535.0f,
+                                   quantized_vertices[i].position[2] / 65535.0f,
+                                   1.0f);
+    EXPECT_NEAR(position.x, vertices()[i].position.x, 1e-4f);
+    EXPECT_NEAR(position.y, vertices()[i].position.y, 1e-4f);
+    EXPECT_NEAR(position.z, vertices()[i].position.z, 1e-4f);
+  }
+}
+
+TEST_F(TriangleTest, RunsFunctionOncePerThreadGivenThreadPool) {
+  vka::ThreadPool thread_pool;
+  thread_pool.initialize(4);
+  EXPECT_EQ(thread_pool.get_thread_count(), 4u);
+  for (size_t run = 0; run < 3; ++run) {
+    std::vector<size_t> calls(4, 0);
+    thread_pool.run([&calls](const size_t thread_index) {
+      ++calls[thread_index];
+    });
+    EXPECT_EQ(calls, std::vector<size_t>(4, 1));
+  }
+}
+
+TEST_F(TriangleTest, RethrowsExceptionGivenThreadPoolFunctionThrows) {
+  vka::ThreadPool thread_pool;
+  thread_pool.initialize(4);
+  const auto failing_function = [](const size_t thread_index) {
+    if (thread_index == 2) {
+      throw std::runtime_error("job failed");
+    }
+  };
+  EXPECT_THROW(thread_pool.run(failing_function), std::runtime_error);
+  std::vector<size_t> calls(4, 0);
+  thread_pool.run(
+      [&calls](const size_t thread_index) { ++calls[thread_index]; });
+  EXPECT_EQ(calls, std::vector<size_t>(4, 1));
+}
+
+#ifdef VKA_ENABLE_PROFILER
+TEST_F(TriangleTest, RecordsProfileEventGivenProfileZone) {
+  vka::flush_profile_events();
+  { VKA_PROFILE_ZONE("zone"); }
+  const std::vector<vka::ProfileEvent> events = vka::flush_profile_events();
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_STREQ(events[0].name, "zone");
+  EXPECT_LE(events[0].begin, events[0].end);
+  EXPECT_TRUE(vka::flush_profile_events().empty());
+}
+
+TEST_F(TriangleTest, ReusesProfileBufferGivenThreadHasExited) {
+  vka::flush_profile_events();
+  std::thread([] { VKA_PROFILE_ZONE("first"); }).join();
+  const std::vector<vka::ProfileEvent> first = vka::flush_profile_events();
+  std::thread([] { VKA_PROFILE_ZONE("second"); }).join();
+  const std::vector<vka::ProfileEvent> second = vka::flush_profile_events();
+  ASSERT_EQ(first.size(), 1u);
+  ASSERT_EQ(second.size(), 1u);
+  EXPECT_EQ(second[0].thread_index, first[0].thread_index);
+}
+
+TEST_F(TriangleTest, ReturnsChromeTraceGivenProfileEvents) {
+  const std::string trace = vka::to_chrome_trace({{"zone", 1, 2000, 5000}});
+  EXPECT_NE(trace.find("\"name\": \"zone\""), std::string::npos);
+  EXPECT_NE(trace.find("\"ph\": \"X\""), std::string::npos);
+  EXPECT_NE(trace.find("\"tid\": 1"), std::string::npos);
+  EXPECT_NE(trace.find("\"ts\": 2.000"), std::string::npos);
+  EXPECT_NE(trace.find("\"dur\": 3.000"), std::string::npos);
+}
+#endif
+
+TEST_F(TriangleTest, LoadsMeshAssetGivenObjFile) {
+  std::ofstream("asset.obj") << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\n"
+                                "f 1/1 2/1 3/1\n";
+  std::remove("asset.obj.mesh");
+  std::unique_ptr<vka::MeshAsset> asset =
+      vka::load_mesh_asset("asset.obj", vka::VertexLayout::quantized);
+  EXPECT_EQ(asset->mesh.vertex_count, 3u);
+  EXPECT_EQ(asset->mesh.index_count, 3u);
+  EXPECT_EQ(asset->mesh.index_type, vk::IndexType::eUint16);
+  EXPECT_EQ(asset->vertex_data.size(), 3 * sizeof(vka::QuantizedVertex));
+  asset.reset();
+  std::remove("asset.obj");
+  std::remove("asset.obj.mesh");
+}
+
+TEST_F(TriangleTest, SkipsVertexPackingGivenFullLayout) {
+  std::ofstream("full.obj") << "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\n"
+                               "f 1/1 2/1 3/1\n";
+  std::remove("full.obj.mesh");
+  std::unique_ptr<vka::MeshAsset> asset =
+      vka::load_mesh_asset("full.obj", vka::VertexLayout::full);
+  EXPECT_EQ(asset->mesh.vertex_count, 3u);
+  EXPECT_TRUE(asset->vertex_data.empty());
+  asset.reset();
+  std::remove("full.obj");
+  std::remove("full.obj.mesh");
+}
+
+TEST_F(TriangleTest, LoadsFallbackImageGivenMissingKtxFiles) {
+  const std::unique_ptr<vka::TextureAsset> asset = vka::load_texture_asset(
+      physical_device(), {"missing.ktx"}, "texture.jpg");
+  EXPECT_EQ(asset->texture.format, vk::Format::eR8G8B8A8Unorm);
+  EXPECT_EQ(asset->texture.width, 512u);
+  EXPECT_EQ(asset->mip_level_count, 10u);
+}
+
+TEST_F(TriangleTest, ThrowsExceptionGivenMissingFallbackImage) {
+  EXPECT_THROW(vka::load_texture_asset(physical_device(), {"missing.ktx"},
+                                       "missing.jpg"),
+               std::runtime_error);
+}
+
+TEST_F(TriangleTest, ReturnsElapsedMilliseconds) {
+  const auto start_time = std::chrono::high_resolution_clock::now();
+  EXPECT_DOUBLE_EQ(vka::get_elapsed_milliseconds(
+                       start_time, start_time + std::chrono::milliseconds(5)),
+                   5.0);
+}
+
+TEST_F(TriangleTest, ReturnsTrueGivenUncompressedTextureFormat) {
+  EXPECT_TRUE(vka::is_texture_format_supported(physical_device(),
+                                               vk::Format::eR8G8B8A8Unorm));
+}
+
+TEST_F(TriangleTest, ReturnsMipLevelCountOfFullChain) {
+  EXPECT_EQ(vka::get_mip_level_count(512, 512), 10u);
+  EXPECT_EQ(vka::get_mip_level_count(1024, 1), 11u);
+  EXPECT_EQ(vka::get_mip_level_count(1, 1), 1u);
+}
+
+TEST_F(TriangleTest, ReturnsImageLevelSizeGivenBlockCompressedFormat) {
+  EXPECT_EQ(vka::get_image_level_size(vk::Format::eBc1RgbaUnormBlock, 5, 4),
+            16u);
+  EXPECT_EQ(vka::get_image_level_size(vk::Format::eBc3UnormBlock, 1, 1), 16u);
+  EXPECT_EQ(vka::get_image_level_size(vk::Format::eR8G8B8A8Unorm, 2, 3), 24u);
+}
+
+TEST_F(TriangleTest, AveragesPixelsGivenDownsampledImage) {
+  const std::vector<uint8_t> image = {0,   0,   0,   0,   255, 255, 255, 255,
+                                      255, 255, 255, 255, 0,   0,   0,   0};
+  const std::vector<uint8_t> level = vka::downsample_rgba8(image.data(), 2, 2);
+  EXPECT_EQ(level, std::vector<uint8_t>({128, 128, 128, 128}));
+}
+
+TEST_F(TriangleTest, AveragesPixelsGivenDownsampledWideImage) {
+  std::vector<uint8_t> image(7 * 2 * 4);
+  for (size_t i = 0; i < image.size(); ++i) {
+    image[i] = static_cast<uint8_t>(i * 9);
+  }
+  const std::vector<uint8_t> level = vka::downsample_rgba8(image.data(), 7, 2);
+  ASSERT_EQ(level.size(), 3u * 4u);
+  for (size_t x = 0; x < 3; ++x) {
+    for (size_t c = 0; c < 4; ++c) {
+      const uint32_t sum = image[x * 8 + c] + image[x * 8 + 4 + c] +
+                           image[28 + x * 8 + c] + image[28 + x * 8 + 4 + c];
+      EXPECT_EQ(level[x * 4 + c], (sum + 2) / 4);
+    }
+  }
+}
+
+TEST_F(TriangleTest, GeneratesFullChainGivenRgba8Image) {
+  const std::vector<uint8_t> image(16 * 4 * 4, 32);
+  const std::vector<std::vector<uint8_t>> levels =
+      vka::generate_mipmaps_rgba8(image.data(), 16, 4);
+  ASSERT_EQ(levels.size(), 4u);
+  EXPECT_EQ(levels[0].size(), 8u * 2u * 4u);
+  EXPECT_EQ(levels[3], std::vector<uint8_t>({32, 32, 32, 32}));
+}
+
+TEST_F(TriangleTest, EncodesSolidColorGivenBc1Block) {
+  std::vector<uint8_t> block(64);
+  for (size_t i = 0; i < 16; ++i) {
+    block[i * 4 + 0] = 255;
+    block[i * 4 + 3] = 255;
+  }
+  uint8_t output[8];
+  vka::compress_bc1_block(block.data(), output);
+  EXPECT_EQ(output[0] | (output[1] << 8), 0xF800);
+  EXPECT_EQ(output[2] | (output[3] << 8), 0xF800);
+  EXPECT_EQ(output[4] | output[5] | output[6] | output[7], 0);
+}
+
+TEST_F(TriangleTest, EncodesAlphaEndpointsGivenBc3Block) {
+  std::vector<uint8_t> block(64);
+  for (size_t i = 0; i < 16; ++i) {
+    block[i * 4 + 3] = i % 2 == 0 ? 10 : 200;
+  }
+  uint8_t output[16];
+  vka::compress_bc3_block(block.data(), output);
+  EXPECT_EQ(output[0], 200);
+  EXPECT_EQ(output[1], 10);
+}
+
+TEST_F(TriangleTest, ReadsLevelsGivenWrittenKtxFile) {
+  const std::vector<uint8_t> image(8 * 8 * 4, 64);
+  const std::vector<uint8_t> compressed =
+      vka::compress_rgba8(image.data(), 8, 8, vk::Format::eBc1RgbaUnormBlock);
+  const std::vector<uint8_t> level = vka::compress_rgba8(
+      image.data(), 4, 4, vk::Format::eBc1RgbaUnormBlock);
+  vka::write_ktx("test.ktx", vk::Format::eBc1RgbaUnormBlock,
+                 {{compressed.data(), static_cast<uint32_t>(compressed.size()),
+                   8, 8},
+                  {level.data(), static_cast<uint32_t>(level.size()), 4, 4}});
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("test.ktx"));
+  vka::KtxTexture texture;
+  ASSERT_TRUE(vka::read_ktx(file, texture));
+  EXPECT_EQ(texture.format, vk::Format::eBc1RgbaUnormBlock);
+  EXPECT_EQ(texture.width, 8u);
+  ASSERT_EQ(texture.levels.size(), 2u);
+  EXPECT_EQ(texture.levels[1].width, 4u);
+  EXPECT_EQ(std::memcmp(texture.levels[0].data, compressed.data(),
+                        compressed.size()),
+            0);
+  file.close();
+  std::remove("test.ktx");
+}
+
+TEST_F(TriangleTest, ReturnsFalseGivenKtxFileWithInvalidIdentifier) {
+  std::ofstream("invalid.ktx", std::ios::binary) << std::string(128, 'x');
+  vka::MappedFile file;
+  ASSERT_TRUE(file.open("invalid.ktx"));
+  vka::KtxTexture texture;
+  EXPECT_FALSE(vka::read_ktx(file, texture));
+  file.close();
+  std::remove("invalid.ktx");
+}
@@ -15,9 +15,32 @@
  */
 
 #include "triangle.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <unordered_map>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define VKA_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <glm/gtc/matrix_transform.hpp>
 #define STB_IMAGE_IMPLEMENTATION
@@ -55,6 +78,14 @@ Texture::Texture(const std::string &file_name) : Texture() {
   height = static_cast<uint32_t>(tmp_height);
   size = width * height * STBI_rgb_alpha;
 }
+double get_elapsed_milliseconds(
+    const std::chrono::time_point<std::chrono::high_resolution_clock>
+        start_time,
+    const std::chrono::time_point<std::chrono::high_resolution_clock>
+        end_time) {
+  return std::chrono::duration<double, std::milli>(end_time - start_time)
+      .count();
+}
 float get_delta_time_per_second(
     const std::chrono::time_point<std::chrono::high_resolution_clock>
         start_time,
@@ -68,7 +99,317 @@ bool Vertex::operator==(const Vertex &other) const {
   return position == other.position && color == other.color &&
          texture_coordinates == other.texture_coordinates;
 }
-Model::Model(const std::string &file_name) {
+uint64_t mix_bits(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xff51afd7ed558ccdull;
+  value ^= value >> 33;
+  value *= 0xc4ceb9fe1a85ec53ull;
+  value ^= value >> 33;
+  return value;
+}
+uint64_t hash_vertex(const Vertex &vertex) {
+  static_assert(sizeof(Vertex) == 8 * sizeof(float),
+                "Vertex must consist of 8 tightly packed floats");
+  float values[8];
+  std::memcpy(values, &vertex, sizeof(values));
+  for (auto &value : values) {
+    value += 0.0f;
+  }
+  uint64_t words[4];
+  std::memcpy(words, values, sizeof(words));
+  uint64_t hash = 0x9e3779b97f4a7c15ull;
+  for (const auto &word : words) {
+    hash = mix_bits(hash ^ word) * 0x100000001b3ull;
+  }
+  return mix_bits(hash);
+}
+struct VertexTable {
+  std::vector<uint32_t> slots;
+  size_t mask;
+};
+VertexTable create_vertex_table(const size_t max_vertex_count) {
+  size_t capacity = 16;
+  while (capacity < max_vertex_count * 2) {
+    capacity *= 2;
+  }
+  VertexTable table;
+  table.slots.assign(capacity, UINT32_MAX);
+  table.mask = capacity - 1;
+  return table;
+}
+uint32_t insert_vertex(VertexTable &table, const Vertex &vertex,
+                       const uint64_t hash, std::vector<Vertex> &vertices,
+                       std::vector<uint64_t> &hashes) {
+  size_t slot = static_cast<size_t>(hash) & table.mask;
+  while (table.slots[slot] != UINT32_MAX) {
+    const uint32_t index = table.slots[slot];
+    if (hashes[index] == hash && vertices[index] == vertex) {
+      return index;
+    }
+    slot = (slot + 1) & table.mask;
+  }
+  const uint32_t index = static_cast<uint32_t>(vertices.size());
+  table.slots[slot] = index;
+  vertices.push_back(vertex);
+  hashes.push_back(hash);
+  return index;
+}
+static void parallel_for(const size_t count,
+                         const std::function<void(const size_t)> &function) {
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < count; ++i) {
+    threads.emplace_back(function, i);
+  }
+  if (count > 0) {
+    function(0);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+ThreadPool::~ThreadPool() { release(); }
+void ThreadPool::initialize(const size_t thread_count) {
+  release();
+  is_stopping_ = false;
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads_.emplace_back(&ThreadPool::work, this, i, generation_);
+  }
+}
+void ThreadPool::run(const std::function<void(const size_t)> &function) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    function_ = &function;
+    pending_count_ = threads_.size();
+    ++generation_;
+  }
+  is_work_ready_.notify_all();
+  try {
+    function(0);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!exception_) {
+      exception_ = std::current_exception();
+    }
+  }
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    is_work_finished_.wait(lock, [this]() { return pending_count_ == 0; });
+    std::swap(exception, exception_);
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+size_t ThreadPool::get_thread_count() const { return threads_.size() + 1; }
+void ThreadPool::release() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  is_work_ready_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+void ThreadPool::work(const size_t thread_index, size_t generation) {
+  while (true) {
+    const std::function<void(const size_t)> *function = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      is_work_ready_.wait(lock, [this, generation]() {
+        return is_stopping_ || generation_ != generation;
+      });
+      if (is_stopping_) {
+        return;
+      }
+      generation = generation_;
+      function = function_;
+    }
+    std::exception_ptr exception;
+    try {
+      (*function)(thread_index);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (exception && !exception_) {
+        exception_ = exception;
+      }
+      --pending_count_;
+    }
+    is_work_finished_.notify_one();
+  }
+}
+#ifdef VKA_ENABLE_PROFILER
+const size_t profile_buffer_capacity = 65536;
+const auto profile_epoch = std::chrono::high_resolution_clock::now();
+struct ProfileBuffer {
+  ProfileBuffer()
+      : events(profile_buffer_capacity), write_count(0), read_count(0),
+        thread_index(0), is_released(false) {}
+  std::vector<ProfileEvent> events;
+  std::atomic<size_t> write_count;
+  std::atomic<size_t> read_count;
+  uint32_t thread_index;
+  bool is_released;
+};
+struct ProfileRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ProfileBuffer>> buffers;
+  std::vector<ProfileBuffer *> free_buffers;
+};
+ProfileRegistry &get_profile_registry() {
+  static ProfileRegistry registry;
+  return registry;
+}
+struct ThreadProfileBuffer {
+  ThreadProfileBuffer() {
+    ProfileRegistry &registry = get_profile_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (!registry.free_buffers.empty()) {
+      buffer = registry.free_buffers.back();
+      registry.free_buffers.pop_back();
+      return;
+    }
+    registry.buffers.emplace_back(new ProfileBuffer());
+    buffer = registry.buffers.back().get();
+    buffer->thread_index = static_cast<uint32_t>(registry.buffers.size() - 1);
+  }
+  ~ThreadProfileBuffer() {
+    ProfileRegistry &registry = get_profile_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffer->is_released = true;
+  }
+  ProfileBuffer *buffer;
+};
+ProfileBuffer &get_thread_profile_buffer() {
+  thread_local ThreadProfileBuffer thread_buffer;
+  return *thread_buffer.buffer;
+}
+int64_t get_profile_nanoseconds(
+    const std::chrono::time_point<std::chrono::high_resolution_clock> time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time -
+                                                              profile_epoch)
+      .count();
+}
+ProfileZone::ProfileZone(const char *name)
+    : name_(name), start_time_(std::chrono::high_resolution_clock::now()) {}
+ProfileZone::~ProfileZone() {
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  ProfileBuffer &buffer = get_thread_profile_buffer();
+  const size_t write_count =
+      buffer.write_count.load(std::memory_order_relaxed);
+  const size_t read_count = buffer.read_count.load(std::memory_order_acquire);
+  if (write_count - read_count >= profile_buffer_capacity) {
+    return;
+  }
+  ProfileEvent &event = buffer.events[write_count % profile_buffer_capacity];
+  event.name = name_;
+  event.thread_index = buffer.thread_index;
+  event.begin = get_profile_nanoseconds(start_time_);
+  event.end = get_profile_nanoseconds(end_time);
+  buffer.write_count.store(write_count + 1, std::memory_order_release);
+}
+std::vector<ProfileEvent> flush_profile_events() {
+  std::vector<ProfileEvent> events;
+  ProfileRegistry &registry = get_profile_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (const auto &buffer : registry.buffers) {
+    const size_t write_count =
+        buffer->write_count.load(std::memory_order_acquire);
+    const size_t read_count =
+        buffer->read_count.load(std::memory_order_relaxed);
+    for (size_t i = read_count; i < write_count; ++i) {
+      events.push_back(buffer->events[i % profile_buffer_capacity]);
+    }
+    buffer->read_count.store(write_count, std::memory_order_release);
+    if (buffer->is_released) {
+      buffer->is_released = false;
+      registry.free_buffers.push_back(buffer.get());
+    }
+  }
+  return events;
+}
+std::string to_chrome_trace(const std::vector<ProfileEvent> &events) {
+  std::ostringstream stream;
+  stream.setf(std::ios::fixed);
+  stream.precision(3);
+  stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (size_t i = 0; i < events.size(); ++i) {
+    stream << (i > 0 ? ",\n" : "\n") << "{\"name\": \"" << events[i].name
+           << "\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 0, \"tid\": "
+           << events[i].thread_index << ", \"ts\": " << events[i].begin / 1000.0
+           << ", \"dur\": " << (events[i].end - events[i].begin) / 1000.0
+           << "}";
+  }
+  stream << "\n]}\n";
+  return stream.str();
+}
+void write_profile_trace(const std::string &file_name,
+                         const std::vector<ProfileEvent> &events) {
+  const std::string trace = to_chrome_trace(events);
+  write_file(file_name, std::vector<char>(trace.begin(), trace.end()));
+}
+#endif
+struct VertexChunk {
+  std::vector<Vertex> vertices;
+  std::vector<uint64_t> hashes;
+  std::vector<uint32_t> remap;
+};
+void deduplicate_vertices(const std::vector<Vertex> &vertices,
+                          const uint32_t thread_count,
+                          std::vector<Vertex> &unique_vertices,
+                          std::vector<uint32_t> &indices) {
+  const size_t min_chunk_size = 16384;
+  const size_t count = vertices.size();
+  const size_t chunk_count = std::max<size_t>(
+      1, std::min<size_t>(thread_count, count / min_chunk_size));
+  const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+  std::vector<VertexChunk> chunks(chunk_count);
+  indices.resize(count);
+  parallel_for(chunk_count, [&](const size_t c) {
+    const size_t begin = c * chunk_size;
+    const size_t end = std::min(begin + chunk_size, count);
+    VertexTable table = create_vertex_table(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+      indices[i] = insert_vertex(table, vertices[i], hash_vertex(vertices[i]),
+                                 chunks[c].vertices, chunks[c].hashes);
+    }
+  });
+
+  if (chunk_count == 1) {
+    unique_vertices = std::move(chunks[0].vertices);
+    return;
+  }
+
+  size_t local_vertex_count = 0;
+  for (const auto &chunk : chunks) {
+    local_vertex_count += chunk.vertices.size();
+  }
+  VertexTable table = create_vertex_table(local_vertex_count);
+  std::vector<uint64_t> hashes;
+  unique_vertices.clear();
+  for (auto &chunk : chunks) {
+    chunk.remap.resize(chunk.vertices.size());
+    for (size_t i = 0; i < chunk.vertices.size(); ++i) {
+      chunk.remap[i] = insert_vertex(table, chunk.vertices[i],
+                                     chunk.hashes[i], unique_vertices, hashes);
+    }
+  }
+
+  parallel_for(chunk_count, [&](const size_t c) {
+    const size_t begin = c * chunk_size;
+    const size_t end = std::min(begin + chunk_size, count);
+    for (size_t i = begin; i < end; ++i) {
+      indices[i] = chunks[c].remap[indices[i]];
+    }
+  });
+}
+std::vector<Vertex> load_obj_vertices(const std::string &file_name) {
   tinyobj::attrib_t attributes;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -76,8 +417,7 @@ Model::Model(const std::string &file_name) {
 
   tinyobj::LoadObj(&attributes, &shapes, &materials, &error, file_name.c_str());
 
-  std::unordered_map<Vertex, uint32_t> unique_vertices;
-
+  std::vector<Vertex> vertices;
   for (const auto &shape : shapes) {
     for (const auto &index : shape.mesh.indices) {
       Vertex vertex;
@@ -88,39 +428,1214 @@ Model::Model(const std::string &file_name) {
           attributes.texcoords[2 * index.texcoord_index + 0],
           1.0f - attributes.texcoords[2 * index.texcoord_index + 1]};
       vertex.color = {1.0f, 1.0f, 1.0f};
+      vertices.push_back(vertex);
+    }
+  }
+  return vertices;
+}
+void split_mesh(const uint32_t max_vertex_count, std::vector<Vertex> &vertices,
+                std::vector<uint32_t> &indices,
+                std::vector<SubMesh> &submeshes) {
+  submeshes.clear();
+  if (vertices.size() <= max_vertex_count) {
+    submeshes.push_back({0, static_cast<uint32_t>(indices.size()), 0});
+    return;
+  }
+
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<uint32_t> used_vertices;
+  std::vector<Vertex> split_vertices;
+  std::vector<uint32_t> split_indices;
+  split_indices.reserve(indices.size());
+  SubMesh submesh = {0, 0, 0};
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    uint32_t new_vertex_count = 0;
+    for (size_t j = 0; j < 3; ++j) {
+      const uint32_t index = indices[i + j];
+      if (remap[index] == UINT32_MAX && (j < 1 || index != indices[i]) &&
+          (j < 2 || index != indices[i + 1])) {
+        ++new_vertex_count;
+      }
+    }
+    if (used_vertices.size() + new_vertex_count > max_vertex_count) {
+      submeshes.push_back(submesh);
+      for (const auto &index : used_vertices) {
+        remap[index] = UINT32_MAX;
+      }
+      used_vertices.clear();
+      submesh = {static_cast<uint32_t>(split_indices.size()), 0,
+                 static_cast<int32_t>(split_vertices.size())};
+    }
+    for (size_t j = 0; j < 3; ++j) {
+      const uint32_t index = indices[i + j];
+      if (remap[index] == UINT32_MAX) {
+        remap[index] = static_cast<uint32_t>(used_vertices.size());
+        used_vertices.push_back(index);
+        split_vertices.push_back(vertices[index]);
+      }
+      split_indices.push_back(remap[index]);
+    }
+    submesh.index_count += 3;
+  }
+  if (submesh.index_count > 0) {
+    submeshes.push_back(submesh);
+  }
+  vertices.swap(split_vertices);
+  indices.swap(split_indices);
+}
+uint32_t get_index_size(const vk::IndexType index_type) {
+  return index_type == vk::IndexType::eUint16 ? sizeof(uint16_t)
+                                               : sizeof(uint32_t);
+}
+VertexCacheStatistics
+analyze_vertex_cache(const std::vector<uint32_t> &indices,
+                     const uint32_t vertex_count, const uint32_t cache_size) {
+  std::vector<uint32_t> timestamps(vertex_count, 0);
+  uint32_t time = cache_size + 1;
+  uint32_t transform_count = 0;
+  uint32_t used_vertex_count = 0;
+  for (const auto &index : indices) {
+    if (timestamps[index] == 0) {
+      ++used_vertex_count;
+    }
+    if (time - timestamps[index] > cache_size) {
+      timestamps[index] = time++;
+      ++transform_count;
+    }
+  }
+
+  VertexCacheStatistics statistics = {0.0f, 0.0f};
+  if (indices.size() >= 3) {
+    statistics.acmr = transform_count / (indices.size() / 3.0f);
+    statistics.atvr = transform_count / static_cast<float>(used_vertex_count);
+  }
+  return statistics;
+}
+float get_vertex_cache_score(const int32_t cache_position,
+                             const uint32_t remaining_triangle_count) {
+  if (remaining_triangle_count == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cache_position >= 0 && cache_position < 3) {
+    score = 0.75f;
+  } else if (cache_position >= 3) {
+    score = std::pow(1.0f - (cache_position - 3) /
+                                static_cast<float>(vertex_cache_size - 3),
+                     1.5f);
+  }
+  return score +
+         2.0f / std::sqrt(static_cast<float>(remaining_triangle_count));
+}
+void optimize_vertex_cache(std::vector<uint32_t> &indices,
+                           const uint32_t vertex_count) {
+  const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+  if (triangle_count == 0) {
+    return;
+  }
+
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+    ++offsets[indices[i] + 1];
+  }
+  std::vector<uint32_t> remaining_triangle_counts(vertex_count);
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    remaining_triangle_counts[i] = offsets[i + 1];
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<uint32_t> adjacency(triangle_count * 3);
+  std::vector<uint32_t> positions(offsets.begin(), offsets.end() - 1);
+  for (uint32_t i = 0; i < triangle_count * 3; ++i) {
+    adjacency[positions[indices[i]]++] = i / 3;
+  }
+
+  std::vector<int32_t> cache_positions(vertex_count, -1);
+  std::vector<float> vertex_scores(vertex_count);
+  for (uint32_t i = 0; i < vertex_count; ++i) {
+    vertex_scores[i] =
+        get_vertex_cache_score(-1, remaining_triangle_counts[i]);
+  }
+  std::vector<float> triangle_scores(triangle_count);
+  std::vector<bool> is_emitted(triangle_count, false);
+  uint32_t best_triangle = 0;
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    triangle_scores[i] = vertex_scores[indices[i * 3]] +
+                         vertex_scores[indices[i * 3 + 1]] +
+                         vertex_scores[indices[i * 3 + 2]];
+    if (triangle_scores[i] > triangle_scores[best_triangle]) {
+      best_triangle = i;
+    }
+  }
+
+  std::vector<uint32_t> optimized_indices;
+  optimized_indices.reserve(triangle_count * 3);
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> next_cache;
+  uint32_t next_unemitted_triangle = 0;
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    if (best_triangle == UINT32_MAX) {
+      while (is_emitted[next_unemitted_triangle]) {
+        ++next_unemitted_triangle;
+      }
+      best_triangle = next_unemitted_triangle;
+    }
+    is_emitted[best_triangle] = true;
+    const uint32_t *triangle = indices.data() + best_triangle * 3;
+    optimized_indices.insert(optimized_indices.end(), triangle, triangle + 3);
+
+    next_cache.clear();
+    for (uint32_t j = 0; j < 3; ++j) {
+      --remaining_triangle_counts[triangle[j]];
+      if (std::find(next_cache.begin(), next_cache.end(), triangle[j]) ==
+          next_cache.end()) {
+        next_cache.push_back(triangle[j]);
+      }
+    }
+    for (const auto &vertex : cache) {
+      if (std::find(next_cache.begin(), next_cache.end(), vertex) ==
+          next_cache.end()) {
+        next_cache.push_back(vertex);
+      }
+    }
+
+    for (size_t j = 0; j < next_cache.size(); ++j) {
+      const uint32_t vertex = next_cache[j];
+      cache_positions[vertex] =
+          j < vertex_cache_size ? static_cast<int32_t>(j) : -1;
+      const float score = get_vertex_cache_score(
+          cache_positions[vertex], remaining_triangle_counts[vertex]);
+      const float score_delta = score - vertex_scores[vertex];
+      vertex_scores[vertex] = score;
+      for (uint32_t k = offsets[vertex]; k < offsets[vertex + 1]; ++k) {
+        triangle_scores[adjacency[k]] += score_delta;
+      }
+    }
+    next_cache.resize(std::min<size_t>(next_cache.size(), vertex_cache_size));
+    cache.swap(next_cache);
+
+    best_triangle = UINT32_MAX;
+    float best_score = -1.0f;
+    for (const auto &vertex : cache) {
+      for (uint32_t k = offsets[vertex]; k < offsets[vertex + 1]; ++k) {
+        const uint32_t candidate = adjacency[k];
+        if (!is_emitted[candidate] && triangle_scores[candidate] > best_score) {
+          best_triangle = candidate;
+          best_score = triangle_scores[candidate];
+        }
+      }
+    }
+  }
+  indices.swap(optimized_indices);
+}
+void optimize_overdraw(const std::vector<Vertex> &vertices,
+                       std::vector<uint32_t> &indices,
+                       const uint32_t cache_size) {
+  const uint32_t triangle_count = static_cast<uint32_t>(indices.size() / 3);
+  if (triangle_count == 0) {
+    return;
+  }
+
+  std::vector<uint32_t> cluster_offsets;
+  std::vector<uint32_t> timestamps(vertices.size(), 0);
+  uint32_t time = cache_size + 1;
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    uint32_t miss_count = 0;
+    for (uint32_t j = 0; j < 3; ++j) {
+      const uint32_t index = indices[i * 3 + j];
+      if (time - timestamps[index] > cache_size) {
+        timestamps[index] = time++;
+        ++miss_count;
+      }
+    }
+    if (i == 0 || miss_count == 3) {
+      cluster_offsets.push_back(i);
+    }
+  }
+  cluster_offsets.push_back(triangle_count);
+
+  glm::vec3 mesh_centroid(0.0f);
+  for (const auto &vertex : vertices) {
+    mesh_centroid += vertex.position;
+  }
+  mesh_centroid /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+  const size_t cluster_count = cluster_offsets.size() - 1;
+  std::vector<float> cluster_scores(cluster_count);
+  for (size_t i = 0; i < cluster_count; ++i) {
+    glm::vec3 centroid(0.0f);
+    glm::vec3 normal(0.0f);
+    float area = 0.0f;
+    for (uint32_t j = cluster_offsets[i]; j < cluster_offsets[i + 1]; ++j) {
+      const glm::vec3 &p0 = vertices[indices[j * 3]].position;
+      const glm::vec3 &p1 = vertices[indices[j * 3 + 1]].position;
+      const glm::vec3 &p2 = vertices[indices[j * 3 + 2]].position;
+      const glm::vec3 triangle_normal = glm::cross(p1 - p0, p2 - p0);
+      const float triangle_area = glm::length(triangle_normal);
+      centroid += (p0 + p1 + p2) * (triangle_area / 3.0f);
+      normal += triangle_normal;
+      area += triangle_area;
+    }
+    const float normal_length = glm::length(normal);
+    cluster_scores[i] =
+        area > 0.0f && normal_length > 0.0f
+            ? glm::dot(centroid / area - mesh_centroid, normal / normal_length)
+            : 0.0f;
+  }
+
+  std::vector<uint32_t> clusters(cluster_count);
+  std::iota(clusters.begin(), clusters.end(), 0);
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [&cluster_scores](const uint32_t a, const uint32_t b) {
+                     return cluster_scores[a] > cluster_scores[b];
+                   });
+
+  std::vector<uint32_t> sorted_indices;
+  sorted_indices.reserve(indices.size());
+  for (const auto &cluster : clusters) {
+    sorted_indices.insert(sorted_indices.end(),
+                          indices.begin() + cluster_offsets[cluster] * 3,
+                          indices.begin() + cluster_offsets[cluster + 1] * 3);
+  }
+  indices.swap(sorted_indices);
+}
+void optimize_vertex_fetch(std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &indices) {
+  std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+  std::vector<Vertex> fetch_vertices;
+  fetch_vertices.reserve(vertices.size());
+  for (auto &index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = static_cast<uint32_t>(fetch_vertices.size());
+      fetch_vertices.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+  vertices.swap(fetch_vertices);
+}
+void optimize_mesh(std::vector<Vertex> &vertices,
+                   std::vector<uint32_t> &indices,
+                   const bool is_overdraw_optimized) {
+  optimize_vertex_cache(indices, static_cast<uint32_t>(vertices.size()));
+  if (is_overdraw_optimized) {
+    optimize_overdraw(vertices, indices, vertex_cache_size);
+  }
+  optimize_vertex_fetch(vertices, indices);
+}
+Model::Model(const std::string &file_name, const bool is_optimized) {
+  deduplicate_vertices(load_obj_vertices(file_name),
+                       std::max(1u, std::thread::hardware_concurrency()),
+                       vertices, indices);
+  if (is_optimized) {
+    optimize_mesh(vertices, indices, true);
+  }
+  split_mesh(max_short_index_vertex_count, vertices, indices, submeshes);
+  short_indices.assign(indices.begin(), indices.end());
+  indices.clear();
+}
+MappedFile::~MappedFile() { close(); }
+#ifdef _WIN32
+bool MappedFile::open(const std::string &file_name) {
+  close();
+  HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  file_ = file;
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+    close();
+    return false;
+  }
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping_) {
+    close();
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(
+      MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  if (!data_) {
+    close();
+    return false;
+  }
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  return true;
+}
+void MappedFile::close() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_) {
+    CloseHandle(mapping_);
+  }
+  if (file_) {
+    CloseHandle(file_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+  file_ = nullptr;
+}
+#else
+bool MappedFile::open(const std::string &file_name) {
+  close();
+  const int file = ::open(file_name.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+  struct stat file_status;
+  if (fstat(file, &file_status) != 0 || file_status.st_size == 0) {
+    ::close(file);
+    return false;
+  }
+  void *pointer = mmap(nullptr, static_cast<size_t>(file_status.st_size),
+                       PROT_READ, MAP_PRIVATE, file, 0);
+  ::close(file);
+  if (pointer == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<const uint8_t *>(pointer);
+  size_ = static_cast<size_t>(file_status.st_size);
+  return true;
+}
+void MappedFile::close() {
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+#endif
+const uint8_t *MappedFile::data() const { return data_; }
+size_t MappedFile::size() const { return size_; }
+uint64_t hash_fnv1a(const uint8_t *data, const size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+uint64_t hash_file(const std::string &file_name) {
+  MappedFile file;
+  if (!file.open(file_name)) {
+    throw std::runtime_error("Failed to open file: " + file_name);
+  }
+  return hash_fnv1a(file.data(), file.size());
+}
+MeshView get_mesh_view(const Model &model) {
+  MeshView mesh;
+  mesh.vertices = model.vertices.data();
+  mesh.vertex_count = static_cast<uint32_t>(model.vertices.size());
+  if (model.short_indices.empty()) {
+    mesh.indices = model.indices.data();
+    mesh.index_count = static_cast<uint32_t>(model.indices.size());
+    mesh.index_type = vk::IndexType::eUint32;
+  } else {
+    mesh.indices = model.short_indices.data();
+    mesh.index_count = static_cast<uint32_t>(model.short_indices.size());
+    mesh.index_type = vk::IndexType::eUint16;
+  }
+  mesh.submeshes = model.submeshes.data();
+  mesh.submesh_count = static_cast<uint32_t>(model.submeshes.size());
+  return mesh;
+}
+std::vector<SubMesh> get_submeshes(const MeshView &mesh) {
+  if (mesh.submesh_count == 0) {
+    return {{0, mesh.index_count, 0}};
+  }
+  return std::vector<SubMesh>(mesh.submeshes,
+                              mesh.submeshes + mesh.submesh_count);
+}
+void write_mesh_cache(const std::string &file_name, const uint64_t source_hash,
+                      const Model &model) {
+  const MeshView mesh = get_mesh_view(model);
+  MeshCacheHeader header = {};
+  header.magic = mesh_cache_magic;
+  header.version = mesh_cache_version;
+  header.source_hash = source_hash;
+  header.vertex_size = sizeof(Vertex);
+  header.vertex_count = mesh.vertex_count;
+  header.index_count = mesh.index_count;
+  header.index_size = get_index_size(mesh.index_type);
+  header.submesh_count = mesh.submesh_count;
+
+  const size_t indices_size =
+      static_cast<size_t>(header.index_count) * header.index_size;
+  const char padding[4] = {};
+  const std::string temp_file_name = file_name + ".tmp";
+  std::ofstream f(temp_file_name, std::ios::binary);
+  f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  f.write(reinterpret_cast<const char *>(mesh.vertices),
+          sizeof(Vertex) * mesh.vertex_count);
+  f.write(reinterpret_cast<const char *>(mesh.indices), indices_size);
+  f.write(padding, align_size(indices_size, 4) - indices_size);
+  f.write(reinterpret_cast<const char *>(mesh.submeshes),
+          sizeof(SubMesh) * mesh.submesh_count);
+  f.close();
+  if (!f) {
+    std::remove(temp_file_name.c_str());
+    return;
+  }
+  std::remove(file_name.c_str());
+  if (std::rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+    std::remove(temp_file_name.c_str());
+  }
+}
+bool read_mesh_cache(const MappedFile &file, const uint64_t source_hash,
+                     MeshView &mesh) {
+  if (file.size() < sizeof(MeshCacheHeader)) {
+    return false;
+  }
+  MeshCacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (header.magic != mesh_cache_magic ||
+      header.version != mesh_cache_version ||
+      header.source_hash != source_hash ||
+      header.vertex_size != sizeof(Vertex) || header.vertex_count == 0 ||
+      header.index_count == 0 ||
+      (header.index_size != sizeof(uint16_t) &&
+       header.index_size != sizeof(uint32_t))) {
+    return false;
+  }
+  const size_t vertices_size =
+      static_cast<size_t>(header.vertex_count) * sizeof(Vertex);
+  const size_t indices_size = static_cast<size_t>(align_size(
+      static_cast<vk::DeviceSize>(header.index_count) * header.index_size, 4));
+  const size_t submeshes_size =
+      static_cast<size_t>(header.submesh_count) * sizeof(SubMesh);
+  if (file.size() !=
+      sizeof(header) + vertices_size + indices_size + submeshes_size) {
+    return false;
+  }
+  const uint8_t *vertices = file.data() + sizeof(header);
+  mesh.vertices = reinterpret_cast<const Vertex *>(vertices);
+  mesh.vertex_count = header.vertex_count;
+  mesh.indices = vertices + vertices_size;
+  mesh.index_count = header.index_count;
+  mesh.index_type = header.index_size == sizeof(uint16_t)
+                        ? vk::IndexType::eUint16
+                        : vk::IndexType::eUint32;
+  const uint8_t *submeshes = vertices + vertices_size + indices_size;
+  for (uint32_t i = 0; i < header.submesh_count; ++i) {
+    SubMesh submesh;
+    std::memcpy(&submesh, submeshes + i * sizeof(SubMesh), sizeof(submesh));
+    if (static_cast<uint64_t>(submesh.first_index) + submesh.index_count >
+            header.index_count ||
+        submesh.vertex_offset < 0 ||
+        static_cast<uint32_t>(submesh.vertex_offset) >= header.vertex_count) {
+      return false;
+    }
+  }
+  mesh.submeshes = reinterpret_cast<const SubMesh *>(submeshes);
+  mesh.submesh_count = header.submesh_count;
+  return true;
+}
+MeshView load_mesh(const std::string &file_name, MappedFile &cache_file,
+                   Model &model) {
+  const uint64_t source_hash = hash_file(file_name);
+  const std::string cache_file_name = file_name + ".mesh";
+
+  MeshView mesh;
+  if (cache_file.open(cache_file_name) &&
+      read_mesh_cache(cache_file, source_hash, mesh)) {
+    return mesh;
+  }
+  cache_file.close();
+
+  model = Model(file_name);
+  write_mesh_cache(cache_file_name, source_hash, model);
+  return get_mesh_view(model);
+}
+const uint8_t ktx_identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31,
+                                    0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+const uint32_t ktx_endianness = 0x04030201;
+const uint32_t ktx_base_internal_format_rgba = 0x1908;
+struct KtxHeader {
+  uint8_t identifier[12];
+  uint32_t endianness;
+  uint32_t gl_type;
+  uint32_t gl_type_size;
+  uint32_t gl_format;
+  uint32_t gl_internal_format;
+  uint32_t gl_base_internal_format;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t array_element_count;
+  uint32_t face_count;
+  uint32_t mip_level_count;
+  uint32_t key_value_data_size;
+};
+const std::vector<KtxFormat> &get_ktx_formats() {
+  static const std::vector<KtxFormat> formats = {
+      {vk::Format::eR8G8B8A8Unorm, 0x1401, 0x1908, 0x8058, 4, false},
+      {vk::Format::eBc1RgbaUnormBlock, 0, 0, 0x83F1, 8, true},
+      {vk::Format::eBc3UnormBlock, 0, 0, 0x83F3, 16, true},
+      {vk::Format::eBc7UnormBlock, 0, 0, 0x8E8C, 16, true}};
+  return formats;
+}
+const KtxFormat *find_ktx_format(const vk::Format format) {
+  for (const auto &ktx_format : get_ktx_formats()) {
+    if (ktx_format.format == format) {
+      return &ktx_format;
+    }
+  }
+  return nullptr;
+}
+const KtxFormat *find_ktx_format(const KtxHeader &header) {
+  for (const auto &ktx_format : get_ktx_formats()) {
+    if (ktx_format.gl_internal_format == header.gl_internal_format &&
+        ktx_format.gl_type == header.gl_type &&
+        ktx_format.gl_format == header.gl_format) {
+      return &ktx_format;
+    }
+  }
+  return nullptr;
+}
+uint32_t get_mip_level_count(const uint32_t width, const uint32_t height) {
+  uint32_t count = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+    ++count;
+  }
+  return count;
+}
+uint32_t get_image_level_size(const vk::Format format, const uint32_t width,
+                              const uint32_t height) {
+  const KtxFormat *ktx_format = find_ktx_format(format);
+  if (!ktx_format) {
+    throw std::runtime_error("Unsupported texture format");
+  }
+  if (ktx_format->is_compressed) {
+    return ((width + 3) / 4) * ((height + 3) / 4) * ktx_format->block_size;
+  }
+  return width * height * ktx_format->block_size;
+}
+std::vector<uint8_t> downsample_rgba8(const uint8_t *data,
+                                      const uint32_t width,
+                                      const uint32_t height) {
+  const uint32_t level_width = std::max(width / 2, 1u);
+  const uint32_t level_height = std::max(height / 2, 1u);
+  std::vector<uint8_t> level(level_width * level_height * 4);
+  for (uint32_t y = 0; y < level_height; ++y) {
+    const uint8_t *row0 = data + std::min(y * 2, height - 1) * width * 4;
+    const uint8_t *row1 = data + std::min(y * 2 + 1, height - 1) * width * 4;
+    uint8_t *output = level.data() + y * level_width * 4;
+    uint32_t x = 0;
+#ifdef VKA_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(2);
+    for (; x * 2 + 3 < width; x += 2) {
+      const __m128i pixels0 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(row0 + x * 8));
+      const __m128i pixels1 =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(row1 + x * 8));
+      const __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(pixels0, zero),
+                                        _mm_unpacklo_epi8(pixels1, zero));
+      const __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(pixels0, zero),
+                                         _mm_unpackhi_epi8(pixels1, zero));
+      const __m128i sum =
+          _mm_unpacklo_epi64(_mm_add_epi16(low, _mm_srli_si128(low, 8)),
+                             _mm_add_epi16(high, _mm_srli_si128(high, 8)));
+      const __m128i average =
+          _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(output + x * 4),
+                       _mm_packus_epi16(average, zero));
+    }
+#endif
+    for (; x < level_width; ++x) {
+      const uint32_t x0 = std::min(x * 2, width - 1) * 4;
+      const uint32_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+      for (uint32_t c = 0; c < 4; ++c) {
+        const uint32_t sum =
+            row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+        output[x * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+      }
+    }
+  }
+  return level;
+}
+std::vector<std::vector<uint8_t>>
+generate_mipmaps_rgba8(const uint8_t *data, const uint32_t width,
+                       const uint32_t height) {
+  std::vector<std::vector<uint8_t>> levels;
+  uint32_t level_width = width;
+  uint32_t level_height = height;
+  for (uint32_t i = 1; i < get_mip_level_count(width, height); ++i) {
+    levels.push_back(downsample_rgba8(data, level_width, level_height));
+    data = levels.back().data();
+    level_width = std::max(level_width / 2, 1u);
+    level_height = std::max(level_height / 2, 1u);
+  }
+  return levels;
+}
+uint16_t pack_rgb565(const uint8_t *color) {
+  return static_cast<uint16_t>(((color[0] >> 3) << 11) |
+                               ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+void unpack_rgb565(const uint16_t packed, uint32_t *color) {
+  const uint32_t r = (packed >> 11) & 0x1F;
+  const uint32_t g = (packed >> 5) & 0x3F;
+  const uint32_t b = packed & 0x1F;
+  color[0] = (r << 3) | (r >> 2);
+  color[1] = (g << 2) | (g >> 4);
+  color[2] = (b << 3) | (b >> 2);
+}
+void compress_bc1_block(const uint8_t *block, uint8_t *output) {
+  uint8_t min_color[3] = {255, 255, 255};
+  uint8_t max_color[3] = {0, 0, 0};
+  int32_t mean[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < 16; ++i) {
+    for (uint32_t c = 0; c < 3; ++c) {
+      min_color[c] = std::min(min_color[c], block[i * 4 + c]);
+      max_color[c] = std::max(max_color[c], block[i * 4 + c]);
+      mean[c] += block[i * 4 + c];
+    }
+  }
 
-      if (unique_vertices.count(vertex) == 0) {
-        unique_vertices[vertex] = static_cast<uint32_t>(vertices.size());
-        vertices.push_back(vertex);
+  uint32_t axis = 0;
+  for (uint32_t c = 1; c < 3; ++c) {
+    if (max_color[c] - min_color[c] > max_color[axis] - min_color[axis]) {
+      axis = c;
+    }
+  }
+  for (uint32_t c = 0; c < 3; ++c) {
+    int32_t covariance = 0;
+    for (uint32_t i = 0; i < 16; ++i) {
+      covariance += (block[i * 4 + axis] * 16 - mean[axis]) *
+                    (block[i * 4 + c] * 16 - mean[c]) / 256;
+    }
+    if (covariance < 0) {
+      std::swap(min_color[c], max_color[c]);
+    }
+  }
+
+  uint16_t color0 = pack_rgb565(max_color);
+  uint16_t color1 = pack_rgb565(min_color);
+  if (color0 < color1) {
+    std::swap(color0, color1);
+  }
+
+  uint32_t palette[4][3];
+  unpack_rgb565(color0, palette[0]);
+  unpack_rgb565(color1, palette[1]);
+  for (uint32_t c = 0; c < 3; ++c) {
+    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+  }
+
+  uint32_t indices = 0;
+  if (color0 != color1) {
+    for (uint32_t i = 0; i < 16; ++i) {
+      uint32_t best_index = 0;
+      uint32_t best_distance = UINT32_MAX;
+      for (uint32_t p = 0; p < 4; ++p) {
+        uint32_t distance = 0;
+        for (uint32_t c = 0; c < 3; ++c) {
+          const int32_t delta = static_cast<int32_t>(block[i * 4 + c]) -
+                                static_cast<int32_t>(palette[p][c]);
+          distance += static_cast<uint32_t>(delta * delta);
+        }
+        if (distance < best_distance) {
+          best_distance = distance;
+          best_index = p;
+        }
       }
+      indices |= best_index << (i * 2);
+    }
+  }
+
+  output[0] = static_cast<uint8_t>(color0 & 0xFF);
+  output[1] = static_cast<uint8_t>(color0 >> 8);
+  output[2] = static_cast<uint8_t>(color1 & 0xFF);
+  output[3] = static_cast<uint8_t>(color1 >> 8);
+  for (uint32_t i = 0; i < 4; ++i) {
+    output[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+  }
+}
+void compress_bc3_block(const uint8_t *block, uint8_t *output) {
+  uint8_t min_alpha = 255;
+  uint8_t max_alpha = 0;
+  for (uint32_t i = 0; i < 16; ++i) {
+    min_alpha = std::min(min_alpha, block[i * 4 + 3]);
+    max_alpha = std::max(max_alpha, block[i * 4 + 3]);
+  }
+
+  uint32_t palette[8] = {max_alpha, min_alpha};
+  for (uint32_t p = 1; p < 7; ++p) {
+    palette[p + 1] = ((7 - p) * max_alpha + p * min_alpha) / 7;
+  }
 
-      indices.push_back(unique_vertices[vertex]);
+  uint64_t indices = 0;
+  if (max_alpha != min_alpha) {
+    for (uint32_t i = 0; i < 16; ++i) {
+      uint64_t best_index = 0;
+      int32_t best_distance = INT32_MAX;
+      for (uint32_t p = 0; p < 8; ++p) {
+        const int32_t delta = static_cast<int32_t>(block[i * 4 + 3]) -
+                              static_cast<int32_t>(palette[p]);
+        const int32_t distance = delta * delta;
+        if (distance < best_distance) {
+          best_distance = distance;
+          best_index = p;
+        }
+      }
+      indices |= best_index << (i * 3);
     }
   }
+
+  output[0] = max_alpha;
+  output[1] = min_alpha;
+  for (uint32_t i = 0; i < 6; ++i) {
+    output[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+  }
+  compress_bc1_block(block, output + 8);
 }
-vk::VertexInputBindingDescription get_binding_description() {
-  vk::VertexInputBindingDescription description;
-  description.binding = 0;
-  description.stride = sizeof(Vertex);
-  description.inputRate = vk::VertexInputRate::eVertex;
-  return description;
+std::vector<uint8_t> compress_rgba8(const uint8_t *data, const uint32_t width,
+                                    const uint32_t height,
+                                    const vk::Format format) {
+  if (format == vk::Format::eR8G8B8A8Unorm) {
+    return std::vector<uint8_t>(data, data + width * height * 4);
+  }
+  if (format != vk::Format::eBc1RgbaUnormBlock &&
+      format != vk::Format::eBc3UnormBlock) {
+    throw std::runtime_error("Unsupported texture compression format");
+  }
+  const uint32_t block_size = find_ktx_format(format)->block_size;
+  std::vector<uint8_t> compressed(get_image_level_size(format, width, height));
+  uint8_t *output = compressed.data();
+  uint8_t block[64];
+  for (uint32_t block_y = 0; block_y < height; block_y += 4) {
+    for (uint32_t block_x = 0; block_x < width; block_x += 4) {
+      for (uint32_t i = 0; i < 16; ++i) {
+        const uint32_t x = std::min(block_x + i % 4, width - 1);
+        const uint32_t y = std::min(block_y + i / 4, height - 1);
+        std::memcpy(block + i * 4, data + (y * width + x) * 4, 4);
+      }
+      if (format == vk::Format::eBc1RgbaUnormBlock) {
+        compress_bc1_block(block, output);
+      } else {
+        compress_bc3_block(block, output);
+      }
+      output += block_size;
+    }
+  }
+  return compressed;
 }
-std::vector<vk::VertexInputAttributeDescription> get_attribute_descriptions() {
-  std::vector<vk::VertexInputAttributeDescription> descriptions(3);
+void write_ktx(const std::string &file_name, const vk::Format format,
+               const std::vector<ImageLevel> &levels) {
+  const KtxFormat *ktx_format = find_ktx_format(format);
+  if (!ktx_format || levels.empty()) {
+    throw std::runtime_error("Failed to write KTX file: " + file_name);
+  }
+  KtxHeader header = {};
+  std::memcpy(header.identifier, ktx_identifier, sizeof(ktx_identifier));
+  header.endianness = ktx_endianness;
+  header.gl_type = ktx_format->gl_type;
+  header.gl_type_size = 1;
+  header.gl_format = ktx_format->gl_format;
+  header.gl_internal_format = ktx_format->gl_internal_format;
+  header.gl_base_internal_format = ktx_base_internal_format_rgba;
+  header.pixel_width = levels[0].width;
+  header.pixel_height = levels[0].height;
+  header.face_count = 1;
+  header.mip_level_count = static_cast<uint32_t>(levels.size());
+
+  std::ofstream f(file_name, std::ios::binary);
+  f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  const char padding[3] = {};
+  for (const auto &level : levels) {
+    f.write(reinterpret_cast<const char *>(&level.size), sizeof(level.size));
+    f.write(reinterpret_cast<const char *>(level.data), level.size);
+    f.write(padding, (4 - level.size % 4) % 4);
+  }
+}
+bool read_ktx(const MappedFile &file, KtxTexture &texture) {
+  if (file.size() < sizeof(KtxHeader)) {
+    return false;
+  }
+  KtxHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.identifier, ktx_identifier,
+                  sizeof(ktx_identifier)) != 0 ||
+      header.endianness != ktx_endianness || header.pixel_depth != 0 ||
+      header.array_element_count != 0 || header.face_count != 1 ||
+      header.pixel_width == 0 || header.pixel_height == 0) {
+    return false;
+  }
+  const KtxFormat *ktx_format = find_ktx_format(header);
+  if (!ktx_format) {
+    return false;
+  }
+
+  texture.format = ktx_format->format;
+  texture.width = header.pixel_width;
+  texture.height = header.pixel_height;
+  texture.levels.clear();
+
+  const uint32_t level_count = std::max(header.mip_level_count, 1u);
+  size_t offset = sizeof(header) + header.key_value_data_size;
+  uint32_t width = header.pixel_width;
+  uint32_t height = header.pixel_height;
+  for (uint32_t i = 0; i < level_count; ++i) {
+    uint32_t size = 0;
+    if (offset + sizeof(size) > file.size()) {
+      return false;
+    }
+    std::memcpy(&size, file.data() + offset, sizeof(size));
+    offset += sizeof(size);
+    if (size != get_image_level_size(texture.format, width, height) ||
+        offset + size > file.size()) {
+      return false;
+    }
+    texture.levels.push_back({file.data() + offset, size, width, height});
+    offset += align_size(size, 4);
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+  }
+  return true;
+}
+std::unique_ptr<MeshAsset> load_mesh_asset(const std::string &file_name,
+                                           const VertexLayout layout) {
+  VKA_PROFILE_ZONE("load_mesh_asset");
+  std::unique_ptr<MeshAsset> asset(new MeshAsset());
+  asset->mesh = load_mesh(file_name, asset->cache_file, asset->model);
+  asset->bounds = compute_bounding_sphere(asset->mesh);
+  const BoundingBox box = compute_bounding_box(asset->mesh);
+  if (layout != VertexLayout::full) {
+    asset->vertex_data = pack_vertices(asset->mesh, layout, box);
+  }
+  asset->dequantization = get_dequantization_matrix(layout, box);
+  return asset;
+}
+std::unique_ptr<TextureAsset>
+load_texture_asset(const vk::PhysicalDevice &physical_device,
+                   const std::vector<std::string> &file_names,
+                   const std::string &fallback_file_name) {
+  VKA_PROFILE_ZONE("load_texture_asset");
+  std::unique_ptr<TextureAsset> asset(new TextureAsset());
+  KtxTexture &texture = asset->texture;
+  bool is_loaded = false;
+  for (const auto &file_name : file_names) {
+    if (asset->file.open(file_name) && read_ktx(asset->file, texture) &&
+        is_texture_format_supported(physical_device, texture.format)) {
+      is_loaded = true;
+      break;
+    }
+    asset->file.close();
+  }
+
+  if (!is_loaded) {
+    asset->image = Texture(fallback_file_name);
+    if (!asset->image.data) {
+      throw std::runtime_error("Failed to load texture: " +
+                               fallback_file_name);
+    }
+    texture.format = vk::Format::eR8G8B8A8Unorm;
+    texture.width = asset->image.width;
+    texture.height = asset->image.height;
+    texture.levels = {{asset->image.data.get(),
+                       static_cast<uint32_t>(asset->image.size),
+                       asset->image.width, asset->image.height}};
+  }
+
+  asset->mip_level_count = static_cast<uint32_t>(texture.levels.size());
+  if (asset->mip_level_count == 1 &&
+      texture.format == vk::Format::eR8G8B8A8Unorm) {
+    asset->mip_level_count = get_mip_level_count(texture.width, texture.height);
+    if (!is_linear_blit_supported(physical_device, texture.format)) {
+      asset->generated_levels = generate_mipmaps_rgba8(
+          texture.levels[0].data, texture.width, texture.height);
+      for (const auto &level : asset->generated_levels) {
+        const ImageLevel &previous_level = texture.levels.back();
+        texture.levels.push_back({level.data(),
+                                  static_cast<uint32_t>(level.size()),
+                                  std::max(previous_level.width / 2, 1u),
+                                  std::max(previous_level.height / 2, 1u)});
+      }
+    }
+  }
+  return asset;
+}
+std::vector<InstanceData> get_instance_grid(const uint32_t instance_count) {
+  if (instance_count == 0) {
+    throw std::runtime_error("Instance count must be greater than zero");
+  }
+  const uint32_t grid_size = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<float>(instance_count))));
+  const float cell_size = 2.0f / grid_size;
+  std::vector<InstanceData> instances(instance_count);
+  for (uint32_t i = 0; i < instance_count; ++i) {
+    const glm::vec3 position(((i % grid_size) + 0.5f) * cell_size - 1.0f,
+                             ((i / grid_size) + 0.5f) * cell_size - 1.0f,
+                             0.0f);
+    instances[i].model =
+        glm::translate(glm::mat4(1.0f), position) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(cell_size / 2.0f));
+  }
+  return instances;
+}
+BoundingBox compute_bounding_box(const MeshView &mesh) {
+  BoundingBox bounds = {glm::vec3(0.0f), glm::vec3(0.0f)};
+  if (mesh.vertex_count == 0) {
+    return bounds;
+  }
+  bounds.minimum = mesh.vertices[0].position;
+  bounds.maximum = mesh.vertices[0].position;
+  for (uint32_t i = 1; i < mesh.vertex_count; ++i) {
+    bounds.minimum = glm::min(bounds.minimum, mesh.vertices[i].position);
+    bounds.maximum = glm::max(bounds.maximum, mesh.vertices[i].position);
+  }
+  return bounds;
+}
+BoundingSphere compute_bounding_sphere(const MeshView &mesh) {
+  const BoundingBox box = compute_bounding_box(mesh);
+  BoundingSphere bounds = {(box.minimum + box.maximum) * 0.5f, 0.0f};
+  for (uint32_t i = 0; i < mesh.vertex_count; ++i) {
+    bounds.radius = std::max(
+        bounds.radius, glm::distance(bounds.center, mesh.vertices[i].position));
+  }
+  return bounds;
+}
+InstanceBounds get_instance_bounds(const std::vector<InstanceData> &instances,
+                                   const BoundingSphere &bounds) {
+  InstanceBounds instance_bounds;
+  instance_bounds.x.resize(instances.size());
+  instance_bounds.y.resize(instances.size());
+  instance_bounds.z.resize(instances.size());
+  instance_bounds.radius.resize(instances.size());
+  for (size_t i = 0; i < instances.size(); ++i) {
+    const glm::mat4 &model = instances[i].model;
+    const glm::vec4 center = model * glm::vec4(bounds.center, 1.0f);
+    const float scale = std::max(std::max(glm::length(glm::vec3(model[0])),
+                                          glm::length(glm::vec3(model[1]))),
+                                 glm::length(glm::vec3(model[2])));
+    instance_bounds.x[i] = center.x;
+    instance_bounds.y[i] = center.y;
+    instance_bounds.z[i] = center.z;
+    instance_bounds.radius[i] = bounds.radius * scale;
+  }
+  return instance_bounds;
+}
+Frustum extract_frustum(const glm::mat4 &matrix) {
+  glm::vec4 rows[4];
+  for (uint32_t i = 0; i < 4; ++i) {
+    rows[i] = glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+  }
+
+  Frustum frustum;
+  frustum.planes[0] = rows[3] + rows[0];
+  frustum.planes[1] = rows[3] - rows[0];
+  frustum.planes[2] = rows[3] + rows[1];
+  frustum.planes[3] = rows[3] - rows[1];
+  frustum.planes[4] = rows[2];
+  frustum.planes[5] = rows[3] - rows[2];
+  for (auto &plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+void cull_instances(const Frustum &frustum, const InstanceBounds &bounds,
+                    std::vector<uint32_t> &visible_instances) {
+  const uint32_t count = static_cast<uint32_t>(bounds.radius.size());
+  visible_instances.resize(count);
+  uint32_t visible_count = 0;
+  uint32_t i = 0;
+#ifdef VKA_USE_SSE2
+  __m128 planes[6][4];
+  for (uint32_t p = 0; p < 6; ++p) {
+    for (uint32_t c = 0; c < 4; ++c) {
+      planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+    }
+  }
+  const __m128 zero = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4) {
+    const __m128 x = _mm_loadu_ps(bounds.x.data() + i);
+    const __m128 y = _mm_loadu_ps(bounds.y.data() + i);
+    const __m128 z = _mm_loadu_ps(bounds.z.data() + i);
+    const __m128 negative_radius =
+        _mm_sub_ps(zero, _mm_loadu_ps(bounds.radius.data() + i));
+    __m128 is_visible = _mm_cmpeq_ps(zero, zero);
+    for (uint32_t p = 0; p < 6; ++p) {
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+          _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+      is_visible =
+          _mm_and_ps(is_visible, _mm_cmpge_ps(distance, negative_radius));
+    }
+    const int mask = _mm_movemask_ps(is_visible);
+    for (uint32_t j = 0; j < 4; ++j) {
+      visible_instances[visible_count] = i + j;
+      visible_count += (mask >> j) & 1;
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    const glm::vec3 center(bounds.x[i], bounds.y[i], bounds.z[i]);
+    bool is_visible = true;
+    for (const auto &plane : frustum.planes) {
+      is_visible &= glm::dot(glm::vec3(plane), center) + plane.w >=
+                    -bounds.radius[i];
+    }
+    visible_instances[visible_count] = i;
+    visible_count += is_visible ? 1 : 0;
+  }
+  visible_instances.resize(visible_count);
+}
+uint16_t pack_half(const float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t float_exponent = (bits >> 23) & 0xFF;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (float_exponent == 0xFF) {
+    return sign | (mantissa ? 0x7E00 : 0x7C00);
+  }
+  const int32_t exponent = static_cast<int32_t>(float_exponent) - 127 + 15;
+  if (exponent >= 31) {
+    return sign | 0x7C00;
+  }
+
+  uint32_t shift = 13;
+  uint32_t half = (static_cast<uint32_t>(std::max(exponent, 0)) << 10);
+  if (exponent <= 0) {
+    if (exponent < -10) {
+      return sign;
+    }
+    mantissa |= 0x800000;
+    shift = static_cast<uint32_t>(14 - exponent);
+    half = 0;
+  }
+  half |= mantissa >> shift;
+  const uint32_t remainder = mantissa & ((1u << shift) - 1);
+  const uint32_t halfway = 1u << (shift - 1);
+  if (remainder > halfway || (remainder == halfway && (half & 1))) {
+    ++half;
+  }
+  return sign | static_cast<uint16_t>(half);
+}
+uint32_t get_vertex_size(const VertexLayout layout) {
+  switch (layout) {
+  case VertexLayout::compact:
+    return sizeof(CompactVertex);
+  case VertexLayout::quantized:
+    return sizeof(QuantizedVertex);
+  default:
+    return sizeof(Vertex);
+  }
+}
+glm::vec3 get_quantization_extent(const BoundingBox &bounds) {
+  const glm::vec3 extent = bounds.maximum - bounds.minimum;
+  return glm::vec3(extent.x > 0.0f ? extent.x : 1.0f,
+                   extent.y > 0.0f ? extent.y : 1.0f,
+                   extent.z > 0.0f ? extent.z : 1.0f);
+}
+std::vector<uint8_t> pack_vertices(const MeshView &mesh,
+                                   const VertexLayout layout,
+                                   const BoundingBox &bounds) {
+  std::vector<uint8_t> data(get_vertex_size(layout) * mesh.vertex_count);
+  if (layout == VertexLayout::full) {
+    std::memcpy(data.data(), mesh.vertices, data.size());
+  } else if (layout == VertexLayout::compact) {
+    CompactVertex *vertices = reinterpret_cast<CompactVertex *>(data.data());
+    for (uint32_t i = 0; i < mesh.vertex_count; ++i) {
+      vertices[i].position = mesh.vertices[i].position;
+      for (uint32_t j = 0; j < 2; ++j) {
+        vertices[i].texture_coordinates[j] =
+            pack_half(mesh.vertices[i].texture_coordinates[j]);
+      }
+    }
+  } else {
+    const glm::vec3 extent = get_quantization_extent(bounds);
+    QuantizedVertex *vertices =
+        reinterpret_cast<QuantizedVertex *>(data.data());
+    for (uint32_t i = 0; i < mesh.vertex_count; ++i) {
+      const glm::vec3 position = glm::clamp(
+          (mesh.vertices[i].position - bounds.minimum) / extent, 0.0f, 1.0f);
+      for (uint32_t j = 0; j < 3; ++j) {
+        vertices[i].position[j] =
+            static_cast<uint16_t>(std::round(position[j] * 65535.0f));
+      }
+      vertices[i].position[3] = 0;
+      for (uint32_t j = 0; j < 2; ++j) {
+        vertices[i].texture_coordinates[j] =
+            pack_half(mesh.vertices[i].texture_coordinates[j]);
+      }
+    }
+  }
+  return data;
+}
+glm::mat4 get_dequantization_matrix(const VertexLayout layout,
+                                    const BoundingBox &bounds) {
+  if (layout != VertexLayout::quantized) {
+    return glm::mat4(1.0f);
+  }
+  return glm::translate(glm::mat4(1.0f), bounds.minimum) *
+         glm::scale(glm::mat4(1.0f), get_quantization_extent(bounds));
+}
+std::string get_vertex_shader_file_name(const VertexLayout layout,
+                                        const TransformMode transform_mode) {
+  const std::string name =
+      layout == VertexLayout::full ? "vert" : "vert_no_color";
+  return transform_mode == TransformMode::push_constants ? name + "_push.spv"
+                                                         : name + ".spv";
+}
+std::vector<vk::VertexInputBindingDescription>
+get_binding_descriptions(const VertexLayout layout) {
+  std::vector<vk::VertexInputBindingDescription> descriptions(2);
   descriptions[0].binding = 0;
-  descriptions[0].location = 0;
-  descriptions[0].format = vk::Format::eR32G32B32Sfloat;
-  descriptions[0].offset = offsetof(Vertex, position);
+  descriptions[0].stride = get_vertex_size(layout);
+  descriptions[0].inputRate = vk::VertexInputRate::eVertex;
+
+  descriptions[1].binding = 1;
+  descriptions[1].stride = sizeof(InstanceData);
+  descriptions[1].inputRate = vk::VertexInputRate::eInstance;
+
+  return descriptions;
+}
+std::vector<vk::VertexInputAttributeDescription>
+get_attribute_descriptions(const VertexLayout layout) {
+  std::vector<vk::VertexInputAttributeDescription> descriptions;
+  if (layout == VertexLayout::full) {
+    descriptions.resize(3);
+    descriptions[0].format = vk::Format::eR32G32B32Sfloat;
+    descriptions[0].offset = offsetof(Vertex, position);
+
+    descriptions[1].location = 1;
+    descriptions[1].format = vk::Format::eR32G32B32Sfloat;
+    descriptions[1].offset = offsetof(Vertex, color);
+
+    descriptions[2].location = 2;
+    descriptions[2].format = vk::Format::eR32G32Sfloat;
+    descriptions[2].offset = offsetof(Vertex, texture_coordinates);
+  } else if (layout == VertexLayout::compact) {
+    descriptions.resize(2);
+    descriptions[0].format = vk::Format::eR32G32B32Sfloat;
+    descriptions[0].offset = offsetof(CompactVertex, position);
+
+    descriptions[1].location = 2;
+    descriptions[1].format = vk::Format::eR16G16Sfloat;
+    descriptions[1].offset = offsetof(CompactVertex, texture_coordinates);
+  } else {
+    descriptions.resize(2);
+    descriptions[0].format = vk::Format::eR16G16B16A16Unorm;
+    descriptions[0].offset = offsetof(QuantizedVertex, position);
 
-  descriptions[1].binding = 0;
-  descriptions[1].location = 1;
-  descriptions[1].format = vk::Format::eR32G32B32Sfloat;
-  descriptions[1].offset = offsetof(Vertex, color);
+    descriptions[1].location = 2;
+    descriptions[1].format = vk::Format::eR16G16Sfloat;
+    descriptions[1].offset = offsetof(QuantizedVertex, texture_coordinates);
+  }
 
-  descriptions[2].binding = 0;
-  descriptions[2].location = 2;
-  descriptions[2].format = vk::Format::eR32G32Sfloat;
-  descriptions[2].offset = offsetof(Vertex, texture_coordinates);
+  for (uint32_t i = 0; i < 4; ++i) {
+    vk::VertexInputAttributeDescription description;
+    description.binding = 1;
+    description.location = 3 + i;
+    description.format = vk::Format::eR32G32B32A32Sfloat;
+    description.offset = static_cast<uint32_t>(offsetof(InstanceData, model) +
+                                               sizeof(glm::vec4) * i);
+    descriptions.push_back(description);
+  }
 
   return descriptions;
 }
@@ -173,6 +1688,32 @@ create_instance(const std::string &name, const Version version,
   info.ppEnabledLayerNames = layer_names.data();
   return vk::createInstanceUnique(info);
 }
+std::vector<const char *>
+select_available_layer_names(const std::vector<const char *> &layer_names,
+                             const std::vector<vk::LayerProperties> &layers) {
+  std::vector<const char *> available_layer_names;
+  for (const auto &layer_name : layer_names) {
+    auto layer = std::find_if(
+        layers.begin(), layers.end(), [&](const vk::LayerProperties &l) {
+          return std::string(l.layerName) == layer_name;
+        });
+    if (layer != layers.end()) {
+      available_layer_names.push_back(layer_name);
+    }
+  }
+  return available_layer_names;
+}
+std::vector<const char *> select_available_extension_names(
+    const std::vector<const char *> &extension_names,
+    const std::vector<vk::ExtensionProperties> &extensions) {
+  std::vector<const char *> available_extension_names;
+  for (const auto &extension_name : extension_names) {
+    if (is_extension_available(extensions, extension_name)) {
+      available_extension_names.push_back(extension_name);
+    }
+  }
+  return available_extension_names;
+}
 vk::PhysicalDevice
 select_physical_device(const std::vector<vk::PhysicalDevice> &devices) {
   if (devices.empty()) {
@@ -191,8 +1732,11 @@ uint32_t find_graphics_queue_family_index(
   }
   return static_cast<uint32_t>(queue - queues.begin());
 }
-vk::UniqueDevice create_device(const vk::PhysicalDevice &physical_device,
-                               const uint32_t queue_index) {
+vk::UniqueDevice
+create_device(const vk::PhysicalDevice &physical_device,
+              const uint32_t queue_index,
+              const std::vector<const char *> &extension_names) {
+  VKA_PROFILE_ZONE("create_device");
   const std::vector<float> queues_priorities = {0.0f};
   vk::DeviceQueueCreateInfo queue_info;
   queue_info.queueCount = 1;
@@ -202,14 +1746,20 @@ vk::UniqueDevice create_device(const vk::PhysicalDevice &physical_device,
   vk::DeviceCreateInfo device_info;
   device_info.queueCreateInfoCount = 1;
   device_info.pQueueCreateInfos = &queue_info;
-  std::vector<const char *> extension_names;
-  extension_names.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
   device_info.enabledExtensionCount =
       static_cast<uint32_t>(extension_names.size());
   device_info.ppEnabledExtensionNames = extension_names.data();
 
+  const vk::PhysicalDeviceFeatures supported_features =
+      physical_device.getFeatures();
   vk::PhysicalDeviceFeatures physical_device_features;
   physical_device_features.samplerAnisotropy = VK_TRUE;
+  physical_device_features.textureCompressionBC =
+      supported_features.textureCompressionBC;
+  physical_device_features.pipelineStatisticsQuery =
+      supported_features.pipelineStatisticsQuery;
+  physical_device_features.inheritedQueries =
+      supported_features.inheritedQueries;
 
   device_info.pEnabledFeatures = &physical_device_features;
 
@@ -221,7 +1771,19 @@ vk::UniqueCommandPool create_command_pool(const vk::Device &device,
   info.queueFamilyIndex = queue_index;
   return device.createCommandPoolUnique(info);
 }
-vk::UniqueBuffer create_buffer(const vk::Device &device, const uint32_t size,
+vk::UniqueFence create_fence(const vk::Device &device, const bool is_signaled) {
+  vk::FenceCreateInfo info;
+  if (is_signaled) {
+    info.flags = vk::FenceCreateFlagBits::eSignaled;
+  }
+  return device.createFenceUnique(info);
+}
+vk::UniqueSemaphore create_semaphore(const vk::Device &device) {
+  vk::SemaphoreCreateInfo info;
+  return device.createSemaphoreUnique(info);
+}
+vk::UniqueBuffer create_buffer(const vk::Device &device,
+                               const vk::DeviceSize size,
                                const vk::BufferUsageFlags usage) {
   vk::BufferCreateInfo info;
   info.size = size;
@@ -256,6 +1818,326 @@ vk::UniqueDeviceMemory allocate_buffer_memory(
                                           buffer_memory_properties);
   return device.allocateMemoryUnique(info);
 }
+vk::DeviceSize align_size(const vk::DeviceSize size,
+                          const vk::DeviceSize alignment) {
+  if (alignment == 0) {
+    return size;
+  }
+  return (size + alignment - 1) / alignment * alignment;
+}
+UniformRingBuffer create_uniform_ring_buffer(
+    const vk::Device &device, MemoryAllocator &allocator,
+    const vk::DeviceSize min_alignment, const vk::DeviceSize element_size,
+    const uint32_t frame_count, const uint32_t slices_per_frame) {
+  UniformRingBuffer ring_buffer;
+  ring_buffer.slice_size = align_size(element_size, min_alignment);
+  ring_buffer.slices_per_frame = slices_per_frame;
+
+  const vk::DeviceSize size =
+      ring_buffer.slice_size * frame_count * slices_per_frame;
+  ring_buffer.buffer =
+      create_buffer(device, static_cast<uint32_t>(size),
+                    vk::BufferUsageFlagBits::eUniformBuffer);
+  ring_buffer.memory = allocate_buffer_memory(
+      device, *ring_buffer.buffer, allocator,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "uniform_buffer");
+  device.bindBufferMemory(*ring_buffer.buffer, ring_buffer.memory.memory,
+                          ring_buffer.memory.offset);
+  ring_buffer.data = ring_buffer.memory.data;
+  return ring_buffer;
+}
+uint32_t get_uniform_slice_offset(const UniformRingBuffer &ring_buffer,
+                                  const uint32_t frame_index,
+                                  const uint32_t slice_index) {
+  return static_cast<uint32_t>(
+      (frame_index * ring_buffer.slices_per_frame + slice_index) *
+      ring_buffer.slice_size);
+}
+bool allocate_range(std::map<vk::DeviceSize, vk::DeviceSize> &free_ranges,
+                    const vk::DeviceSize size, const vk::DeviceSize alignment,
+                    vk::DeviceSize &offset) {
+  for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it) {
+    const vk::DeviceSize range_offset = it->first;
+    const vk::DeviceSize range_size = it->second;
+    const vk::DeviceSize aligned_offset = align_size(range_offset, alignment);
+    const vk::DeviceSize padding = aligned_offset - range_offset;
+    if (padding + size > range_size) {
+      continue;
+    }
+    free_ranges.erase(it);
+    if (padding > 0) {
+      free_ranges[range_offset] = padding;
+    }
+    if (padding + size < range_size) {
+      free_ranges[aligned_offset + size] = range_size - padding - size;
+    }
+    offset = aligned_offset;
+    return true;
+  }
+  return false;
+}
+void free_range(std::map<vk::DeviceSize, vk::DeviceSize> &free_ranges,
+                const vk::DeviceSize offset, const vk::DeviceSize size) {
+  auto it = free_ranges.emplace(offset, size).first;
+  auto next = std::next(it);
+  if (next != free_ranges.end() && it->first + it->second == next->first) {
+    it->second += next->second;
+    free_ranges.erase(next);
+  }
+  if (it != free_ranges.begin()) {
+    auto previous = std::prev(it);
+    if (previous->first + previous->second == it->first) {
+      previous->second += it->second;
+      free_ranges.erase(it);
+    }
+  }
+}
+void MemoryAllocator::initialize(const vk::Device &device,
+                                 const vk::PhysicalDevice &physical_device,
+                                 const vk::DeviceSize block_size) {
+  device_ = device;
+  memory_properties_ = physical_device.getMemoryProperties();
+  block_size_ = block_size;
+  resources_.clear();
+  heap_used_sizes_.assign(memory_properties_.memoryHeapCount, 0);
+  heap_peak_sizes_.assign(memory_properties_.memoryHeapCount, 0);
+}
+vk::DeviceSize
+MemoryAllocator::get_block_size(const uint32_t memory_type_index) const {
+  const uint32_t heap_index =
+      memory_properties_.memoryTypes[memory_type_index].heapIndex;
+  return std::min(block_size_,
+                  memory_properties_.memoryHeaps[heap_index].size / 8);
+}
+MemoryBlock &MemoryAllocator::create_block(const uint32_t memory_type_index,
+                                           const vk::DeviceSize size,
+                                           const bool is_linear) {
+  std::unique_ptr<MemoryBlock> block(new MemoryBlock());
+  vk::MemoryAllocateInfo info;
+  info.allocationSize = size;
+  info.memoryTypeIndex = memory_type_index;
+  block->memory = device_.allocateMemoryUnique(info);
+  block->size = size;
+  block->memory_type_index = memory_type_index;
+  block->is_linear = is_linear;
+  block->data = nullptr;
+  block->allocation_count = 0;
+  block->free_ranges[0] = size;
+
+  if (memory_properties_.memoryTypes[memory_type_index].propertyFlags &
+      vk::MemoryPropertyFlagBits::eHostVisible) {
+    void *pointer;
+    device_.mapMemory(*block->memory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags(),
+                      &pointer);
+    block->data = static_cast<uint8_t *>(pointer);
+  }
+
+  blocks_.push_back(std::move(block));
+  return *blocks_.back();
+}
+void MemoryAllocator::release_block(const MemoryBlock *block) {
+  bool is_spare = block->size > get_block_size(block->memory_type_index);
+  for (const auto &candidate : blocks_) {
+    is_spare = is_spare ||
+               (candidate.get() != block && candidate->allocation_count == 0 &&
+                candidate->memory_type_index == block->memory_type_index &&
+                candidate->is_linear == block->is_linear);
+  }
+  if (!is_spare) {
+    return;
+  }
+  blocks_.erase(std::find_if(blocks_.begin(), blocks_.end(),
+                             [block](const std::unique_ptr<MemoryBlock> &b) {
+                               return b.get() == block;
+                             }));
+}
+uint32_t MemoryAllocator::get_resource_index(const std::string &name,
+                                             const uint32_t memory_type_index) {
+  for (size_t i = 0; i < resources_.size(); ++i) {
+    if (resources_[i].memory_type_index == memory_type_index &&
+        resources_[i].name == name) {
+      return static_cast<uint32_t>(i);
+    }
+  }
+  MemoryResourceStatistics resource = {};
+  resource.name = name;
+  resource.heap_index =
+      memory_properties_.memoryTypes[memory_type_index].heapIndex;
+  resource.memory_type_index = memory_type_index;
+  resources_.push_back(resource);
+  return static_cast<uint32_t>(resources_.size() - 1);
+}
+MemoryAllocation
+MemoryAllocator::allocate(const vk::MemoryRequirements &requirements,
+                          const vk::MemoryPropertyFlags &properties,
+                          const bool is_linear, const std::string &name) {
+  const uint32_t memory_type_index = find_memory_type(
+      memory_properties_, requirements.memoryTypeBits, properties);
+  if (memory_type_index == UINT32_MAX) {
+    throw std::runtime_error("Failed to find a suitable memory type");
+  }
+
+  MemoryBlock *block = nullptr;
+  vk::DeviceSize offset = 0;
+  for (auto &candidate : blocks_) {
+    if (candidate->memory_type_index == memory_type_index &&
+        candidate->is_linear == is_linear &&
+        allocate_range(candidate->free_ranges, requirements.size,
+                       requirements.alignment, offset)) {
+      block = candidate.get();
+      break;
+    }
+  }
+
+  if (!block) {
+    const vk::DeviceSize block_size =
+        std::max(get_block_size(memory_type_index), requirements.size);
+    block = &create_block(memory_type_index, block_size, is_linear);
+    allocate_range(block->free_ranges, requirements.size,
+                   requirements.alignment, offset);
+  }
+  ++block->allocation_count;
+
+  const uint32_t resource_index = get_resource_index(name, memory_type_index);
+  MemoryResourceStatistics &resource = resources_[resource_index];
+  resource.live_size += requirements.size;
+  resource.peak_size = std::max(resource.peak_size, resource.live_size);
+  ++resource.live_count;
+  ++resource.allocation_count;
+  heap_used_sizes_[resource.heap_index] += requirements.size;
+  heap_peak_sizes_[resource.heap_index] =
+      std::max(heap_peak_sizes_[resource.heap_index],
+               heap_used_sizes_[resource.heap_index]);
+
+  MemoryAllocation allocation;
+  allocation.memory = *block->memory;
+  allocation.offset = offset;
+  allocation.size = requirements.size;
+  allocation.data = block->data ? block->data + offset : nullptr;
+  allocation.block = block;
+  allocation.resource_index = resource_index;
+  return allocation;
+}
+void MemoryAllocator::free(MemoryAllocation &allocation) {
+  if (!allocation.block) {
+    return;
+  }
+  free_range(allocation.block->free_ranges, allocation.offset,
+             allocation.size);
+  --allocation.block->allocation_count;
+  MemoryResourceStatistics &resource = resources_[allocation.resource_index];
+  resource.live_size -= allocation.size;
+  --resource.live_count;
+  heap_used_sizes_[resource.heap_index] -= allocation.size;
+  if (allocation.block->allocation_count == 0) {
+    release_block(allocation.block);
+  }
+  allocation = MemoryAllocation();
+}
+std::vector<MemoryHeapStatistics> MemoryAllocator::get_heap_statistics() const {
+  std::vector<MemoryHeapStatistics> statistics(
+      memory_properties_.memoryHeapCount);
+  for (uint32_t i = 0; i < memory_properties_.memoryHeapCount; ++i) {
+    statistics[i].heap_size = memory_properties_.memoryHeaps[i].size;
+    statistics[i].peak_used_size = heap_peak_sizes_[i];
+  }
+  for (const auto &block : blocks_) {
+    const uint32_t heap_index =
+        memory_properties_.memoryTypes[block->memory_type_index].heapIndex;
+    MemoryHeapStatistics &heap = statistics[heap_index];
+    vk::DeviceSize free_size = 0;
+    for (const auto &range : block->free_ranges) {
+      free_size += range.second;
+      heap.largest_free_range = std::max(heap.largest_free_range, range.second);
+    }
+    heap.allocated_size += block->size;
+    heap.used_size += block->size - free_size;
+    ++heap.block_count;
+    heap.allocation_count += block->allocation_count;
+    heap.free_range_count += static_cast<uint32_t>(block->free_ranges.size());
+  }
+  return statistics;
+}
+std::vector<MemoryResourceStatistics>
+MemoryAllocator::get_resource_statistics() const {
+  return resources_;
+}
+void MemoryAllocator::release() { blocks_.clear(); }
+MemoryAllocation allocate_buffer_memory(
+    const vk::Device &device, const vk::Buffer &buffer,
+    MemoryAllocator &allocator,
+    const vk::MemoryPropertyFlags &buffer_memory_properties,
+    const std::string &name) {
+  return allocator.allocate(device.getBufferMemoryRequirements(buffer),
+                            buffer_memory_properties, true, name);
+}
+bool is_extension_available(
+    const std::vector<vk::ExtensionProperties> &extensions,
+    const std::string &name) {
+  return std::any_of(extensions.begin(), extensions.end(),
+                     [&name](const vk::ExtensionProperties &extension) {
+                       return name == extension.extensionName;
+                     });
+}
+void add_memory_budget_instance_extension(
+    std::vector<const char *> &extension_names) {
+#ifdef VK_EXT_memory_budget
+  if (is_extension_available(
+          vk::enumerateInstanceExtensionProperties(),
+          VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+    extension_names.push_back(
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+  }
+#endif
+}
+bool query_memory_budget(const vk::Instance &instance,
+                         const vk::PhysicalDevice &physical_device,
+                         std::vector<MemoryHeapStatistics> &heaps) {
+#ifdef VK_EXT_memory_budget
+  const auto get_memory_properties =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+          instance.getProcAddr("vkGetPhysicalDeviceMemoryProperties2KHR"));
+  if (!get_memory_properties) {
+    return false;
+  }
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+  budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  VkPhysicalDeviceMemoryProperties2KHR properties = {};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+  properties.pNext = &budget;
+  get_memory_properties(physical_device, &properties);
+  for (size_t i = 0; i < heaps.size() && i < VK_MAX_MEMORY_HEAPS; ++i) {
+    heaps[i].budget = budget.heapBudget[i];
+    heaps[i].usage = budget.heapUsage[i];
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+std::string
+format_memory_report(const std::vector<MemoryHeapStatistics> &heaps,
+                     const std::vector<MemoryResourceStatistics> &resources) {
+  std::ostringstream stream;
+  for (size_t i = 0; i < heaps.size(); ++i) {
+    stream << "heap " << i << ": used " << heaps[i].used_size << " peak "
+           << heaps[i].peak_used_size << " allocated "
+           << heaps[i].allocated_size << " of " << heaps[i].heap_size;
+    if (heaps[i].budget > 0) {
+      stream << " budget " << heaps[i].budget << " usage " << heaps[i].usage;
+    }
+    stream << "\n";
+  }
+  for (const auto &resource : resources) {
+    stream << resource.name << " (heap " << resource.heap_index << ", type "
+           << resource.memory_type_index << "): live " << resource.live_size
+           << " in " << resource.live_count << " peak " << resource.peak_size
+           << " allocations " << resource.allocation_count << "\n";
+  }
+  return stream.str();
+}
 template <typename T>
 void fill_buffer(const vk::Device &device,
                  const vk::DeviceMemory &buffer_memory, const T &data) {
@@ -282,6 +2164,15 @@ void fill_buffer(const vk::Device &device,
   std::memcpy(pointer, data.data(), size);
   device.unmapMemory(buffer_memory);
 }
+template void fill_buffer(const vk::Device &device,
+                          const vk::DeviceMemory &buffer_memory,
+                          const UniformBufferObject &data);
+template void fill_buffer(const vk::Device &device,
+                          const vk::DeviceMemory &buffer_memory,
+                          const std::vector<Vertex> &data);
+template void fill_buffer(const vk::Device &device,
+                          const vk::DeviceMemory &buffer_memory,
+                          const std::vector<uint32_t> &data);
 vk::UniqueCommandBuffer begin_command(const vk::Device &device,
                                       const vk::CommandPool &command_pool) {
   std::vector<vk::UniqueCommandBuffer> command_buffers =
@@ -307,6 +2198,39 @@ void end_command(const vk::Device &device,
   queue.submit(submit_info, vk::Fence());
   queue.waitIdle();
 }
+void record_copy_buffer_to_buffer(const vk::CommandBuffer &command_buffer,
+                                  const vk::Buffer &source_buffer,
+                                  const vk::Buffer &destination_buffer,
+                                  const vk::DeviceSize size) {
+  const vk::BufferCopy region(0, 0, size);
+  command_buffer.copyBuffer(source_buffer, destination_buffer, 1, &region);
+}
+void record_copy_buffer_to_image(const vk::CommandBuffer &command_buffer,
+                                 const vk::Buffer &source_buffer,
+                                 const vk::Image &destination_image,
+                                 const uint32_t width, const uint32_t height) {
+  vk::BufferImageCopy region;
+  region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = vk::Extent3D(width, height, 1);
+
+  command_buffer.copyBufferToImage(source_buffer, destination_image,
+                                   vk::ImageLayout::eTransferDstOptimal, 1,
+                                   &region);
+}
+void record_copy_image_to_buffer(const vk::CommandBuffer &command_buffer,
+                                 const vk::Image &source_image,
+                                 const vk::Buffer &destination_buffer,
+                                 const uint32_t width, const uint32_t height) {
+  vk::BufferImageCopy region;
+  region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = vk::Extent3D(width, height, 1);
+
+  command_buffer.copyImageToBuffer(source_image,
+                                   vk::ImageLayout::eTransferSrcOptimal,
+                                   destination_buffer, 1, &region);
+}
 void copy_buffer_to_buffer(const vk::Device &device,
                            const vk::Buffer &source_buffer,
                            const vk::Buffer &destination_buffer,
@@ -314,10 +2238,8 @@ void copy_buffer_to_buffer(const vk::Device &device,
                            const vk::CommandPool &command_pool,
                            const uint32_t queue_index) {
   vk::UniqueCommandBuffer command_buffer = begin_command(device, command_pool);
-
-  const vk::BufferCopy region(0, 0, size);
-  (*command_buffer).copyBuffer(source_buffer, destination_buffer, 1, &region);
-
+  record_copy_buffer_to_buffer(*command_buffer, source_buffer,
+                               destination_buffer, size);
   end_command(device, std::move(command_buffer), queue_index);
 }
 void copy_buffer_to_image(const vk::Device &device,
@@ -327,16 +2249,19 @@ void copy_buffer_to_image(const vk::Device &device,
                           const vk::CommandPool &command_pool,
                           const uint32_t queue_index) {
   vk::UniqueCommandBuffer command_buffer = begin_command(device, command_pool);
-
-  vk::BufferImageCopy region;
-  region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-  region.imageSubresource.layerCount = 1;
-  region.imageExtent = vk::Extent3D(width, height, 1);
-
-  (*command_buffer)
-      .copyBufferToImage(source_buffer, destination_image,
-                         vk::ImageLayout::eTransferDstOptimal, 1, &region);
-
+  record_copy_buffer_to_image(*command_buffer, source_buffer,
+                              destination_image, width, height);
+  end_command(device, std::move(command_buffer), queue_index);
+}
+void copy_image_to_buffer(const vk::Device &device,
+                          const vk::Image &source_image,
+                          const vk::Buffer &destination_buffer,
+                          const uint32_t width, const uint32_t height,
+                          const vk::CommandPool &command_pool,
+                          const uint32_t queue_index) {
+  vk::UniqueCommandBuffer command_buffer = begin_command(device, command_pool);
+  record_copy_image_to_buffer(*command_buffer, source_image,
+                              destination_buffer, width, height);
   end_command(device, std::move(command_buffer), queue_index);
 }
 std::vector<vk::UniqueCommandBuffer>
@@ -349,6 +2274,16 @@ create_command_buffers(const vk::Device &device,
   info.level = vk::CommandBufferLevel::ePrimary;
   return device.allocateCommandBuffersUnique(info);
 }
+std::vector<vk::UniqueCommandBuffer>
+create_secondary_command_buffers(const vk::Device &device,
+                                 const vk::CommandPool &command_pool,
+                                 const uint32_t command_buffer_count) {
+  vk::CommandBufferAllocateInfo info;
+  info.commandPool = command_pool;
+  info.commandBufferCount = command_buffer_count;
+  info.level = vk::CommandBufferLevel::eSecondary;
+  return device.allocateCommandBuffersUnique(info);
+}
 std::vector<vk::Bool32>
 get_presentation_support(const vk::PhysicalDevice &physical_device,
                          const vk::SurfaceKHR &surface,
@@ -395,10 +2330,21 @@ select_swapchain_extent(const vk::SurfaceCapabilitiesKHR &capabilities,
   }
   return extent;
 }
+vk::PresentModeKHR
+select_present_mode(const std::vector<vk::PresentModeKHR> &present_modes,
+                    const vk::PresentModeKHR &requested_present_mode) {
+  if (std::find(present_modes.begin(), present_modes.end(),
+                requested_present_mode) == present_modes.end()) {
+    return vk::PresentModeKHR::eFifo;
+  }
+  return requested_present_mode;
+}
 vk::UniqueSwapchainKHR create_swapchain(
     const vk::SurfaceFormatKHR &surface_format, const vk::Extent2D &extent,
     const vk::SurfaceCapabilitiesKHR &capabilities, const vk::Device &device,
-    const vk::SurfaceKHR &surface, const vk::SwapchainKHR &old_swapchain) {
+    const vk::SurfaceKHR &surface, const vk::SwapchainKHR &old_swapchain,
+    const vk::PresentModeKHR &present_mode) {
+  VKA_PROFILE_ZONE("create_swapchain");
   vk::SwapchainCreateInfoKHR info;
   info.surface = surface;
   info.minImageCount = capabilities.minImageCount;
@@ -411,7 +2357,7 @@ vk::UniqueSwapchainKHR create_swapchain(
   info.imageSharingMode = vk::SharingMode::eExclusive;
   info.queueFamilyIndexCount = 0;
   info.pQueueFamilyIndices = nullptr;
-  info.presentMode = vk::PresentModeKHR::eFifo;
+  info.presentMode = present_mode;
   info.oldSwapchain = old_swapchain;
   info.clipped = VK_TRUE;
   info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
@@ -420,7 +2366,8 @@ vk::UniqueSwapchainKHR create_swapchain(
 vk::UniqueImageView create_image_view(const vk::Device &device,
                                       const vk::Image &image,
                                       const vk::Format &format,
-                                      const vk::ImageAspectFlags &aspect) {
+                                      const vk::ImageAspectFlags &aspect,
+                                      const uint32_t mip_level_count) {
   vk::ImageViewCreateInfo info;
   info.image = image;
   info.viewType = vk::ImageViewType::e2D;
@@ -431,7 +2378,7 @@ vk::UniqueImageView create_image_view(const vk::Device &device,
   info.components.a = vk::ComponentSwizzle::eA;
   info.subresourceRange.aspectMask = aspect;
   info.subresourceRange.baseMipLevel = 0;
-  info.subresourceRange.levelCount = 1;
+  info.subresourceRange.levelCount = mip_level_count;
   info.subresourceRange.baseArrayLayer = 0;
   info.subresourceRange.layerCount = 1;
   return device.createImageViewUnique(info);
@@ -443,7 +2390,7 @@ create_swapchain_image_views(const vk::Device &device,
   std::vector<vk::UniqueImageView> image_views(images.size());
   for (size_t i = 0; i < images.size(); ++i) {
     image_views[i] = create_image_view(device, images[i], surface_format.format,
-                                       vk::ImageAspectFlagBits::eColor);
+                                       vk::ImageAspectFlagBits::eColor, 1);
   }
   return image_views;
 }
@@ -452,6 +2399,38 @@ std::vector<char> read_file(const std::string &file_name) {
   return std::vector<char>((std::istreambuf_iterator<char>(f)),
                            std::istreambuf_iterator<char>());
 }
+void write_file(const std::string &file_name, const std::vector<char> &data) {
+  std::ofstream f(file_name, std::ios::binary);
+  f.write(data.data(), data.size());
+}
+bool is_pipeline_cache_valid(const std::vector<char> &data,
+                             const vk::PhysicalDeviceProperties &properties) {
+  const size_t header_size = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (data.size() < header_size) {
+    return false;
+  }
+  uint32_t header[4];
+  std::memcpy(header, data.data(), sizeof(header));
+  return header[0] >= header_size &&
+         header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header[2] == properties.vendorID &&
+         header[3] == properties.deviceID &&
+         std::memcmp(data.data() + sizeof(header),
+                     properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+vk::UniquePipelineCache
+create_pipeline_cache(const vk::Device &device,
+                      const std::vector<char> &initial_data) {
+  vk::PipelineCacheCreateInfo info;
+  info.initialDataSize = initial_data.size();
+  info.pInitialData = initial_data.data();
+  return device.createPipelineCacheUnique(info);
+}
+std::vector<char> get_pipeline_cache_data(const vk::Device &device,
+                                          const vk::PipelineCache &cache) {
+  const std::vector<uint8_t> data = device.getPipelineCacheData(cache);
+  return std::vector<char>(data.begin(), data.end());
+}
 vk::UniqueShaderModule create_shader_module(const vk::Device &device,
                                             const std::vector<char> &code) {
   vk::ShaderModuleCreateInfo info;
@@ -461,20 +2440,31 @@ vk::UniqueShaderModule create_shader_module(const vk::Device &device,
 }
 vk::UniquePipelineLayout
 create_pipeline_layout(const vk::Device &device,
-                       const vk::DescriptorSetLayout &descriptor_set_layout) {
+                       const vk::DescriptorSetLayout &descriptor_set_layout,
+                       const TransformMode transform_mode) {
+  vk::PushConstantRange push_constant_range;
+  push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex;
+  push_constant_range.offset = 0;
+  push_constant_range.size = sizeof(glm::mat4);
+
   vk::PipelineLayoutCreateInfo info;
   info.setLayoutCount = 1;
   info.pSetLayouts = &descriptor_set_layout;
+  if (transform_mode == TransformMode::push_constants) {
+    info.pushConstantRangeCount = 1;
+    info.pPushConstantRanges = &push_constant_range;
+  }
   return device.createPipelineLayoutUnique(info);
 }
 vk::UniqueRenderPass create_render_pass(const vk::Device &device,
-                                        const vk::Format &surface_format) {
+                                        const vk::Format &surface_format,
+                                        const vk::ImageLayout &final_layout) {
   vk::AttachmentDescription color_attachment;
   color_attachment.format = surface_format;
   color_attachment.loadOp = vk::AttachmentLoadOp::eClear;
   color_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
   color_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-  color_attachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+  color_attachment.finalLayout = final_layout;
 
   vk::AttachmentReference color_attachment_reference;
   color_attachment_reference.attachment = 0;
@@ -502,35 +2492,76 @@ vk::UniqueRenderPass create_render_pass(const vk::Device &device,
   subpass.pColorAttachments = &color_attachment_reference;
   subpass.pDepthStencilAttachment = &depth_attachment_reference;
 
+  vk::SubpassDependency dependency;
+  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass = 0;
+  dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                            vk::PipelineStageFlagBits::eLateFragmentTests;
+  dependency.srcAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+  dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                            vk::PipelineStageFlagBits::eEarlyFragmentTests;
+  dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
+                             vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                             vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+  std::vector<vk::SubpassDependency> dependencies = {dependency};
+
+  if (final_layout == vk::ImageLayout::eTransferSrcOptimal) {
+    vk::SubpassDependency transfer_dependency;
+    transfer_dependency.srcSubpass = 0;
+    transfer_dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    transfer_dependency.srcStageMask =
+        vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    transfer_dependency.srcAccessMask =
+        vk::AccessFlagBits::eColorAttachmentWrite;
+    transfer_dependency.dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+    transfer_dependency.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    dependencies.push_back(transfer_dependency);
+  }
+
   vk::RenderPassCreateInfo info;
   info.attachmentCount = static_cast<uint32_t>(attachments.size());
   info.pAttachments = attachments.data();
   info.subpassCount = 1;
   info.pSubpasses = &subpass;
+  info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  info.pDependencies = dependencies.data();
 
   return device.createRenderPassUnique(info);
 }
-vk::UniqueDescriptorPool create_descriptor_pool(const vk::Device &device) {
-  std::array<vk::DescriptorPoolSize, 2> pool_sizes;
-  pool_sizes[0].type = vk::DescriptorType::eUniformBuffer;
-  pool_sizes[0].descriptorCount = 1;
-  pool_sizes[1].type = vk::DescriptorType::eCombinedImageSampler;
-  pool_sizes[1].descriptorCount = 1;
+std::vector<vk::DescriptorPoolSize> get_descriptor_set_sizes() {
+  return {vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1),
+          vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, 1)};
+}
+vk::UniqueDescriptorPool
+create_descriptor_pool(const vk::Device &device,
+                       const std::vector<vk::DescriptorPoolSize> &set_sizes,
+                       const uint32_t max_sets,
+                       const vk::DescriptorPoolCreateFlags flags) {
+  std::vector<vk::DescriptorPoolSize> pool_sizes = set_sizes;
+  for (auto &pool_size : pool_sizes) {
+    pool_size.descriptorCount *= max_sets;
+  }
 
   vk::DescriptorPoolCreateInfo info;
   info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
   info.pPoolSizes = pool_sizes.data();
-  info.maxSets = 1;
-  info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+  info.maxSets = max_sets;
+  info.flags = flags;
 
   return device.createDescriptorPoolUnique(info);
 }
+vk::UniqueDescriptorPool create_descriptor_pool(const vk::Device &device,
+                                                const uint32_t max_sets) {
+  return create_descriptor_pool(
+      device, get_descriptor_set_sizes(), max_sets,
+      vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+}
 vk::UniqueDescriptorSetLayout
 create_descriptor_set_layout(const vk::Device &device) {
   std::array<vk::DescriptorSetLayoutBinding, 2> bindings;
   bindings[0].binding = 0;
   bindings[0].descriptorCount = 1;
-  bindings[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+  bindings[0].descriptorType = vk::DescriptorType::eUniformBufferDynamic;
   bindings[0].stageFlags = vk::ShaderStageFlagBits::eVertex;
 
   bindings[1].binding = 1;
@@ -569,31 +2600,110 @@ void update_descriptor_sets(
   image_info.imageView = image_view;
   image_info.sampler = sampler;
 
-  std::array<vk::WriteDescriptorSet, 2> descriptor_writes;
-  descriptor_writes[0].dstSet = descriptor_sets[0];
-  descriptor_writes[0].dstBinding = 0;
-  descriptor_writes[0].descriptorType = vk::DescriptorType::eUniformBuffer;
-  descriptor_writes[0].descriptorCount = 1;
-  descriptor_writes[0].pBufferInfo = &buffer_info;
-
-  descriptor_writes[1].dstSet = descriptor_sets[0];
-  descriptor_writes[1].dstBinding = 1;
-  descriptor_writes[1].descriptorType =
-      vk::DescriptorType::eCombinedImageSampler;
-  descriptor_writes[1].descriptorCount = 1;
-  descriptor_writes[1].pImageInfo = &image_info;
+  std::vector<vk::WriteDescriptorSet> descriptor_writes(
+      2 * descriptor_sets.size());
+  for (size_t i = 0; i < descriptor_sets.size(); ++i) {
+    vk::WriteDescriptorSet &buffer_write = descriptor_writes[2 * i];
+    buffer_write.dstSet = descriptor_sets[i];
+    buffer_write.dstBinding = 0;
+    buffer_write.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
+    buffer_write.descriptorCount = 1;
+    buffer_write.pBufferInfo = &buffer_info;
+
+    vk::WriteDescriptorSet &image_write = descriptor_writes[2 * i + 1];
+    image_write.dstSet = descriptor_sets[i];
+    image_write.dstBinding = 1;
+    image_write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    image_write.descriptorCount = 1;
+    image_write.pImageInfo = &image_info;
+  }
 
   device.updateDescriptorSets(descriptor_writes, {});
 }
+void DescriptorAllocator::initialize(
+    const vk::Device &device,
+    const std::vector<vk::DescriptorPoolSize> &set_sizes,
+    const uint32_t sets_per_pool, const uint32_t frame_count) {
+  device_ = device;
+  set_sizes_ = set_sizes;
+  sets_per_pool_ = sets_per_pool;
+  frame_index_ = 0;
+  frame_pools_.clear();
+  frame_pools_.resize(frame_count);
+  frame_set_counts_.assign(frame_count, 0);
+  free_pools_.clear();
+}
+vk::UniqueDescriptorPool DescriptorAllocator::acquire_pool() {
+  if (free_pools_.empty()) {
+    return create_descriptor_pool(device_, set_sizes_, sets_per_pool_,
+                                  vk::DescriptorPoolCreateFlags());
+  }
+  vk::UniqueDescriptorPool pool = std::move(free_pools_.back());
+  free_pools_.pop_back();
+  return pool;
+}
+void DescriptorAllocator::begin_frame(const uint32_t frame_index) {
+  frame_index_ = frame_index;
+  for (auto &pool : frame_pools_[frame_index_]) {
+    device_.resetDescriptorPool(*pool, vk::DescriptorPoolResetFlags());
+    free_pools_.push_back(std::move(pool));
+  }
+  frame_pools_[frame_index_].clear();
+  frame_set_counts_[frame_index_] = 0;
+}
+std::vector<vk::DescriptorSet> DescriptorAllocator::allocate(
+    const vk::DescriptorSetLayout &descriptor_set_layout,
+    const uint32_t count) {
+  std::vector<vk::UniqueDescriptorPool> &pools = frame_pools_[frame_index_];
+  uint32_t &set_count = frame_set_counts_[frame_index_];
+  std::vector<vk::DescriptorSet> descriptor_sets;
+  descriptor_sets.reserve(count);
+  while (descriptor_sets.size() < count) {
+    if (pools.empty() || set_count == sets_per_pool_) {
+      pools.push_back(acquire_pool());
+      set_count = 0;
+    }
+    const uint32_t batch_size =
+        std::min(count - static_cast<uint32_t>(descriptor_sets.size()),
+                 sets_per_pool_ - set_count);
+    const std::vector<vk::DescriptorSetLayout> layouts(batch_size,
+                                                       descriptor_set_layout);
+    vk::DescriptorSetAllocateInfo info;
+    info.descriptorPool = *pools.back();
+    info.descriptorSetCount = batch_size;
+    info.pSetLayouts = layouts.data();
+    const std::vector<vk::DescriptorSet> batch =
+        device_.allocateDescriptorSets(info);
+    descriptor_sets.insert(descriptor_sets.end(), batch.begin(), batch.end());
+    set_count += batch_size;
+  }
+  return descriptor_sets;
+}
+uint32_t DescriptorAllocator::get_pool_count() const {
+  size_t pool_count = free_pools_.size();
+  for (const auto &pools : frame_pools_) {
+    pool_count += pools.size();
+  }
+  return static_cast<uint32_t>(pool_count);
+}
+void DescriptorAllocator::release() {
+  frame_pools_.clear();
+  frame_set_counts_.clear();
+  free_pools_.clear();
+}
 vk::UniquePipeline
 create_graphics_pipeline(const vk::Device &device,
                          const vk::RenderPass &render_pass,
-                         const vk::Extent2D &swapchain_extent,
-                         const vk::PipelineLayout &pipeline_layout) {
+                         const vk::PipelineLayout &pipeline_layout,
+                         const vk::PipelineCache &pipeline_cache,
+                         const VertexLayout vertex_layout,
+                         const TransformMode transform_mode) {
+  VKA_PROFILE_ZONE("create_graphics_pipeline");
   vk::GraphicsPipelineCreateInfo info;
 
-  vk::UniqueShaderModule vertex_shader_module =
-      create_shader_module(device, read_file("vert.spv"));
+  vk::UniqueShaderModule vertex_shader_module = create_shader_module(
+      device,
+      read_file(get_vertex_shader_file_name(vertex_layout, transform_mode)));
   vk::PipelineShaderStageCreateInfo vertex_shader_stage;
   vertex_shader_stage.stage = vk::ShaderStageFlagBits::eVertex;
   vertex_shader_stage.module = *vertex_shader_module;
@@ -612,12 +2722,13 @@ create_graphics_pipeline(const vk::Device &device,
   info.pStages = stages.data();
 
   vk::PipelineVertexInputStateCreateInfo vertex_input_state;
-  vk::VertexInputBindingDescription binding_description =
-      get_binding_description();
+  std::vector<vk::VertexInputBindingDescription> binding_descriptions =
+      get_binding_descriptions(vertex_layout);
   std::vector<vk::VertexInputAttributeDescription> attribute_descriptions =
-      get_attribute_descriptions();
-  vertex_input_state.vertexBindingDescriptionCount = 1;
-  vertex_input_state.pVertexBindingDescriptions = &binding_description;
+      get_attribute_descriptions(vertex_layout);
+  vertex_input_state.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(binding_descriptions.size());
+  vertex_input_state.pVertexBindingDescriptions = binding_descriptions.data();
   vertex_input_state.vertexAttributeDescriptionCount =
       static_cast<uint32_t>(attribute_descriptions.size());
   vertex_input_state.pVertexAttributeDescriptions =
@@ -628,24 +2739,19 @@ create_graphics_pipeline(const vk::Device &device,
   input_assembly_state.topology = vk::PrimitiveTopology::eTriangleList;
   info.pInputAssemblyState = &input_assembly_state;
 
-  vk::Viewport viewport;
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(swapchain_extent.width);
-  viewport.height = static_cast<float>(swapchain_extent.height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  vk::Rect2D scissor;
-  scissor.extent = swapchain_extent;
-
   vk::PipelineViewportStateCreateInfo viewport_state;
   viewport_state.viewportCount = 1;
-  viewport_state.pViewports = &viewport;
   viewport_state.scissorCount = 1;
-  viewport_state.pScissors = &scissor;
   info.pViewportState = &viewport_state;
 
+  std::vector<vk::DynamicState> dynamic_states = {vk::DynamicState::eViewport,
+                                                  vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamic_state;
+  dynamic_state.dynamicStateCount =
+      static_cast<uint32_t>(dynamic_states.size());
+  dynamic_state.pDynamicStates = dynamic_states.data();
+  info.pDynamicState = &dynamic_state;
+
   vk::PipelineRasterizationStateCreateInfo rasterization_state;
   rasterization_state.depthClampEnable = VK_FALSE;
   rasterization_state.rasterizerDiscardEnable = VK_FALSE;
@@ -680,8 +2786,7 @@ create_graphics_pipeline(const vk::Device &device,
 
   info.renderPass = render_pass;
 
-  vk::UniquePipelineCache pipeline_cache;
-  return device.createGraphicsPipelineUnique(*pipeline_cache, info);
+  return device.createGraphicsPipelineUnique(pipeline_cache, info);
 }
 std::vector<vk::UniqueFramebuffer>
 create_framebuffers(const vk::Device &device, const vk::RenderPass &render_pass,
@@ -701,7 +2806,172 @@ create_framebuffers(const vk::Device &device, const vk::RenderPass &render_pass,
     info.layers = 1;
     framebuffers.push_back(device.createFramebufferUnique(info));
   }
-  return framebuffers;
+  return framebuffers;
+}
+void begin_render_pass(const vk::CommandBuffer &command_buffer,
+                       const vk::RenderPass &render_pass,
+                       const vk::Framebuffer &framebuffer,
+                       const vk::Extent2D &swapchain_extent,
+                       const vk::SubpassContents contents) {
+  vk::RenderPassBeginInfo render_pass_begin_info;
+  render_pass_begin_info.renderPass = render_pass;
+  render_pass_begin_info.framebuffer = framebuffer;
+  render_pass_begin_info.renderArea.extent = swapchain_extent;
+
+  std::array<vk::ClearValue, 2> clear_values = {
+      vk::ClearValue(
+          vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f})),
+      vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0))};
+  render_pass_begin_info.clearValueCount =
+      static_cast<uint32_t>(clear_values.size());
+  render_pass_begin_info.pClearValues = clear_values.data();
+
+  command_buffer.beginRenderPass(render_pass_begin_info, contents);
+}
+vk::UniqueQueryPool create_timestamp_query_pool(const vk::Device &device,
+                                                const uint32_t query_count) {
+  vk::QueryPoolCreateInfo info;
+  info.queryType = vk::QueryType::eTimestamp;
+  info.queryCount = query_count;
+  return device.createQueryPoolUnique(info);
+}
+void record_timestamp_begin(const vk::CommandBuffer &command_buffer,
+                            const vk::QueryPool &query_pool,
+                            const uint32_t query) {
+  if (!query_pool) {
+    return;
+  }
+  command_buffer.resetQueryPool(query_pool, query, 2);
+  command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                                query_pool, query);
+}
+void record_timestamp_end(const vk::CommandBuffer &command_buffer,
+                          const vk::QueryPool &query_pool,
+                          const uint32_t query) {
+  if (!query_pool) {
+    return;
+  }
+  command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                                query_pool, query + 1);
+}
+bool read_timestamps(const vk::Device &device, const vk::QueryPool &query_pool,
+                     const uint32_t first_query, const uint32_t query_count,
+                     std::vector<uint64_t> &timestamps) {
+  timestamps.resize(query_count);
+  return device.getQueryPoolResults(
+             query_pool, first_query, query_count,
+             sizeof(uint64_t) * query_count, timestamps.data(),
+             sizeof(uint64_t), vk::QueryResultFlagBits::e64) ==
+         vk::Result::eSuccess;
+}
+double get_timestamp_milliseconds(const uint64_t begin, const uint64_t end,
+                                  const float timestamp_period,
+                                  const uint32_t timestamp_valid_bits) {
+  const uint64_t mask = timestamp_valid_bits >= 64
+                            ? UINT64_MAX
+                            : (uint64_t(1) << timestamp_valid_bits) - 1;
+  return ((end - begin) & mask) * static_cast<double>(timestamp_period) /
+         1000000.0;
+}
+vk::QueryPipelineStatisticFlags get_pipeline_statistic_flags() {
+  return vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+         vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+         vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+         vk::QueryPipelineStatisticFlagBits::eClippingInvocations |
+         vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+         vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+}
+vk::UniqueQueryPool
+create_pipeline_statistics_query_pool(const vk::Device &device,
+                                      const uint32_t query_count) {
+  vk::QueryPoolCreateInfo info;
+  info.queryType = vk::QueryType::ePipelineStatistics;
+  info.queryCount = query_count;
+  info.pipelineStatistics = get_pipeline_statistic_flags();
+  return device.createQueryPoolUnique(info);
+}
+void record_pipeline_statistics_begin(const vk::CommandBuffer &command_buffer,
+                                      const vk::QueryPool &query_pool,
+                                      const uint32_t query) {
+  if (!query_pool) {
+    return;
+  }
+  command_buffer.resetQueryPool(query_pool, query, 1);
+  command_buffer.beginQuery(query_pool, query, vk::QueryControlFlags());
+}
+void record_pipeline_statistics_end(const vk::CommandBuffer &command_buffer,
+                                    const vk::QueryPool &query_pool,
+                                    const uint32_t query) {
+  if (!query_pool) {
+    return;
+  }
+  command_buffer.endQuery(query_pool, query);
+}
+bool read_pipeline_statistics(const vk::Device &device,
+                              const vk::QueryPool &query_pool,
+                              const uint32_t query,
+                              PipelineStatistics &statistics) {
+  static_assert(sizeof(PipelineStatistics) == 6 * sizeof(uint64_t),
+                "PipelineStatistics must hold one counter per statistic flag");
+  return device.getQueryPoolResults(
+             query_pool, query, 1, sizeof(statistics), &statistics,
+             sizeof(statistics), vk::QueryResultFlagBits::e64) ==
+         vk::Result::eSuccess;
+}
+void record_draw_commands(
+    const vk::CommandBuffer &command_buffer,
+    const vk::Pipeline &graphics_pipeline,
+    const vk::PipelineLayout &pipeline_layout,
+    const vk::Extent2D &swapchain_extent, const vk::Buffer &vertex_buffer,
+    const vk::Buffer &instance_buffer, const vk::Buffer &index_buffer,
+    const vk::IndexType index_type, const std::vector<SubMesh> &submeshes,
+    const std::vector<vk::DescriptorSet> &descriptor_sets,
+    const std::vector<DrawCommand> &draw_commands,
+    const TransformMode transform_mode,
+    const std::vector<glm::mat4> &object_models) {
+  command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                              graphics_pipeline);
+
+  vk::Viewport viewport;
+  viewport.width = static_cast<float>(swapchain_extent.width);
+  viewport.height = static_cast<float>(swapchain_extent.height);
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  command_buffer.setViewport(0, viewport);
+
+  vk::Rect2D scissor;
+  scissor.extent = swapchain_extent;
+  command_buffer.setScissor(0, scissor);
+
+  command_buffer.bindVertexBuffers(0, {vertex_buffer, instance_buffer},
+                                   {0, 0});
+  command_buffer.bindIndexBuffer({index_buffer}, {0}, index_type);
+  bool is_bound = false;
+  uint32_t bound_offset = 0;
+  for (size_t i = 0; i < draw_commands.size(); ++i) {
+    const DrawCommand &draw_command = draw_commands[i];
+    if (draw_command.instance_count == 0) {
+      continue;
+    }
+    if (!is_bound || bound_offset != draw_command.dynamic_offset) {
+      command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                                        pipeline_layout, 0, descriptor_sets,
+                                        draw_command.dynamic_offset);
+      is_bound = true;
+      bound_offset = draw_command.dynamic_offset;
+    }
+    if (transform_mode == TransformMode::push_constants) {
+      command_buffer.pushConstants(pipeline_layout,
+                                   vk::ShaderStageFlagBits::eVertex, 0,
+                                   sizeof(glm::mat4), &object_models[i]);
+    }
+    for (const auto &submesh : submeshes) {
+      command_buffer.drawIndexed(submesh.index_count,
+                                 draw_command.instance_count,
+                                 submesh.first_index, submesh.vertex_offset,
+                                 draw_command.first_instance);
+    }
+  }
 }
 void record_command_buffers(
     const vk::Device &device,
@@ -710,70 +2980,137 @@ void record_command_buffers(
     const vk::PipelineLayout &pipeline_layout,
     const std::vector<vk::Framebuffer> &framebuffers,
     const vk::Extent2D &swapchain_extent, const vk::Buffer &vertex_buffer,
-    const vk::Buffer &index_buffer, const std::vector<uint32_t> &indices,
-    const std::vector<vk::DescriptorSet> &descriptor_sets) {
+    const vk::Buffer &instance_buffer, const vk::Buffer &index_buffer,
+    const vk::IndexType index_type, const std::vector<SubMesh> &submeshes,
+    const std::vector<vk::DescriptorSet> &descriptor_sets,
+    const std::vector<DrawCommand> &draw_commands,
+    const TransformMode transform_mode,
+    const std::vector<glm::mat4> &object_models,
+    const vk::QueryPool &timestamp_query_pool,
+    const uint32_t first_timestamp_query,
+    const vk::QueryPool &statistics_query_pool,
+    const uint32_t first_statistics_query) {
+  VKA_PROFILE_ZONE("record_command_buffers");
   for (size_t i = 0; i < command_buffers.size(); ++i) {
     vk::CommandBufferBeginInfo command_buffer_begin_info;
     command_buffer_begin_info.flags =
-        vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+        vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
 
+    const uint32_t timestamp_query =
+        first_timestamp_query + static_cast<uint32_t>(i) * 2;
+    const uint32_t statistics_query =
+        first_statistics_query + static_cast<uint32_t>(i);
     command_buffers[i].begin(command_buffer_begin_info);
-
-    vk::RenderPassBeginInfo render_pass_begin_info;
-    render_pass_begin_info.renderPass = render_pass;
-    render_pass_begin_info.framebuffer = framebuffers[i];
-    render_pass_begin_info.renderArea.extent = swapchain_extent;
-
-    std::array<vk::ClearValue, 2> clear_values = {
-        vk::ClearValue(
-            vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f})),
-        vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0))};
-    render_pass_begin_info.clearValueCount =
-        static_cast<uint32_t>(clear_values.size());
-    render_pass_begin_info.pClearValues = clear_values.data();
-
-    command_buffers[i].beginRenderPass(render_pass_begin_info,
-                                       vk::SubpassContents::eInline);
-    command_buffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics,
-                                    graphics_pipeline);
-    command_buffers[i].bindVertexBuffers(0, {vertex_buffer}, {0});
-    command_buffers[i].bindIndexBuffer({index_buffer}, {0},
-                                       vk::IndexType::eUint32);
-    command_buffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
-                                          pipeline_layout, 0, descriptor_sets,
-                                          {});
-    command_buffers[i].drawIndexed(static_cast<uint32_t>(indices.size()), 1, 0,
-                                   0, 0);
+    record_timestamp_begin(command_buffers[i], timestamp_query_pool,
+                           timestamp_query);
+    record_pipeline_statistics_begin(command_buffers[i], statistics_query_pool,
+                                     statistics_query);
+    begin_render_pass(command_buffers[i], render_pass, framebuffers[i],
+                      swapchain_extent, vk::SubpassContents::eInline);
+    record_draw_commands(command_buffers[i], graphics_pipeline,
+                         pipeline_layout, swapchain_extent, vertex_buffer,
+                         instance_buffer, index_buffer, index_type, submeshes,
+                         descriptor_sets, draw_commands, transform_mode,
+                         object_models);
     command_buffers[i].endRenderPass();
-
+    record_pipeline_statistics_end(command_buffers[i], statistics_query_pool,
+                                   statistics_query);
+    record_timestamp_end(command_buffers[i], timestamp_query_pool,
+                         timestamp_query);
     command_buffers[i].end();
   }
 }
-void draw_frame(const vk::Device &device, const vk::SwapchainKHR &swapchain,
-                const vk::Semaphore &is_image_available,
-                const vk::Semaphore &is_rendering_finished,
-                const std::vector<vk::CommandBuffer> &command_buffers,
-                const uint32_t queue_index) {
-  const uint32_t image_index =
-      device
-          .acquireNextImageKHR(swapchain, UINT64_MAX, is_image_available,
-                               vk::Fence())
-          .value;
-
+void record_secondary_command_buffer(
+    const vk::CommandBuffer &command_buffer, const vk::RenderPass &render_pass,
+    const vk::Framebuffer &framebuffer, const vk::Pipeline &graphics_pipeline,
+    const vk::PipelineLayout &pipeline_layout,
+    const vk::Extent2D &swapchain_extent, const vk::Buffer &vertex_buffer,
+    const vk::Buffer &instance_buffer, const vk::Buffer &index_buffer,
+    const vk::IndexType index_type, const std::vector<SubMesh> &submeshes,
+    const std::vector<vk::DescriptorSet> &descriptor_sets,
+    const std::vector<DrawCommand> &draw_commands,
+    const TransformMode transform_mode,
+    const std::vector<glm::mat4> &object_models,
+    const vk::QueryPipelineStatisticFlags pipeline_statistics) {
+  VKA_PROFILE_ZONE("record_secondary_command_buffer");
+  vk::CommandBufferInheritanceInfo inheritance_info;
+  inheritance_info.renderPass = render_pass;
+  inheritance_info.subpass = 0;
+  inheritance_info.framebuffer = framebuffer;
+  inheritance_info.pipelineStatistics = pipeline_statistics;
+
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+                     vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+  begin_info.pInheritanceInfo = &inheritance_info;
+
+  command_buffer.begin(begin_info);
+  record_draw_commands(command_buffer, graphics_pipeline, pipeline_layout,
+                       swapchain_extent, vertex_buffer, instance_buffer,
+                       index_buffer, index_type, submeshes, descriptor_sets,
+                       draw_commands, transform_mode, object_models);
+  command_buffer.end();
+}
+void record_primary_command_buffer(
+    const vk::CommandBuffer &command_buffer, const vk::RenderPass &render_pass,
+    const vk::Framebuffer &framebuffer, const vk::Extent2D &swapchain_extent,
+    const std::vector<vk::CommandBuffer> &secondary_command_buffers,
+    const vk::QueryPool &timestamp_query_pool, const uint32_t timestamp_query,
+    const vk::QueryPool &statistics_query_pool,
+    const uint32_t statistics_query) {
+  VKA_PROFILE_ZONE("record_primary_command_buffer");
+  vk::CommandBufferBeginInfo begin_info;
+  begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+  command_buffer.begin(begin_info);
+  record_timestamp_begin(command_buffer, timestamp_query_pool,
+                         timestamp_query);
+  record_pipeline_statistics_begin(command_buffer, statistics_query_pool,
+                                   statistics_query);
+  begin_render_pass(command_buffer, render_pass, framebuffer, swapchain_extent,
+                    vk::SubpassContents::eSecondaryCommandBuffers);
+  command_buffer.executeCommands(secondary_command_buffers);
+  command_buffer.endRenderPass();
+  record_pipeline_statistics_end(command_buffer, statistics_query_pool,
+                                 statistics_query);
+  record_timestamp_end(command_buffer, timestamp_query_pool, timestamp_query);
+  command_buffer.end();
+}
+uint32_t acquire_next_image(const vk::Device &device,
+                            const vk::SwapchainKHR &swapchain,
+                            const vk::Semaphore &is_image_available) {
+  VKA_PROFILE_ZONE("acquire_next_image");
+  return device
+      .acquireNextImageKHR(swapchain, UINT64_MAX, is_image_available,
+                           vk::Fence())
+      .value;
+}
+void submit_frame(const vk::Device &device,
+                  const vk::CommandBuffer &command_buffer,
+                  const vk::Semaphore &is_image_available,
+                  const vk::Semaphore &is_rendering_finished,
+                  const vk::Fence &is_frame_finished,
+                  const uint32_t queue_index) {
+  VKA_PROFILE_ZONE("submit_frame");
   vk::SubmitInfo submit_info;
   vk::PipelineStageFlags wait_stages =
       vk::PipelineStageFlagBits::eColorAttachmentOutput;
-  submit_info.waitSemaphoreCount = 1;
+  submit_info.waitSemaphoreCount = is_image_available ? 1 : 0;
   submit_info.pWaitSemaphores = &is_image_available;
   submit_info.pWaitDstStageMask = &wait_stages;
-  submit_info.signalSemaphoreCount = 1;
+  submit_info.signalSemaphoreCount = is_rendering_finished ? 1 : 0;
   submit_info.pSignalSemaphores = &is_rendering_finished;
   submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_buffers[image_index];
+  submit_info.pCommandBuffers = &command_buffer;
 
   vk::Queue queue = device.getQueue(queue_index, 0);
-  queue.submit(submit_info, vk::Fence());
-
+  queue.submit(submit_info, is_frame_finished);
+}
+void present_frame(const vk::Device &device, const vk::SwapchainKHR &swapchain,
+                   const uint32_t image_index,
+                   const vk::Semaphore &is_rendering_finished,
+                   const uint32_t queue_index) {
+  VKA_PROFILE_ZONE("present_frame");
   vk::PresentInfoKHR present_info;
   present_info.waitSemaphoreCount = 1;
   present_info.pWaitSemaphores = &is_rendering_finished;
@@ -781,17 +3118,31 @@ void draw_frame(const vk::Device &device, const vk::SwapchainKHR &swapchain,
   present_info.pSwapchains = &swapchain;
   present_info.pImageIndices = &image_index;
 
+  vk::Queue queue = device.getQueue(queue_index, 0);
   queue.presentKHR(present_info);
-  queue.waitIdle();
+}
+void draw_frame(const vk::Device &device, const vk::SwapchainKHR &swapchain,
+                const vk::Semaphore &is_image_available,
+                const vk::Semaphore &is_rendering_finished,
+                const vk::Fence &is_frame_finished,
+                const std::vector<vk::CommandBuffer> &command_buffers,
+                const uint32_t queue_index) {
+  const uint32_t image_index =
+      acquire_next_image(device, swapchain, is_image_available);
+  submit_frame(device, command_buffers[image_index], is_image_available,
+               is_rendering_finished, is_frame_finished, queue_index);
+  present_frame(device, swapchain, image_index, is_rendering_finished,
+                queue_index);
 }
 vk::UniqueImage create_image(const vk::Device &device, const uint32_t width,
                              const uint32_t height, const vk::Format format,
                              const vk::ImageTiling tiling,
-                             const vk::ImageUsageFlags usage) {
+                             const vk::ImageUsageFlags usage,
+                             const uint32_t mip_level_count) {
   vk::ImageCreateInfo info;
   info.imageType = vk::ImageType::e2D;
   info.extent = vk::Extent3D(width, height, 1);
-  info.mipLevels = 1;
+  info.mipLevels = mip_level_count;
   info.arrayLayers = 1;
   info.format = format;
   info.tiling = tiling;
@@ -811,6 +3162,15 @@ vk::UniqueDeviceMemory allocate_image_memory(
                                           image_memory_properties);
   return device.allocateMemoryUnique(info);
 }
+MemoryAllocation
+allocate_image_memory(const vk::Device &device, const vk::Image &image,
+                      MemoryAllocator &allocator,
+                      const vk::MemoryPropertyFlags &image_memory_properties,
+                      const vk::ImageTiling &tiling, const std::string &name) {
+  return allocator.allocate(device.getImageMemoryRequirements(image),
+                            image_memory_properties,
+                            tiling == vk::ImageTiling::eLinear, name);
+}
 struct TransitionProperties {
   vk::AccessFlags source_mask;
   vk::AccessFlags destination_mask;
@@ -845,14 +3205,11 @@ get_transition_properties(const vk::ImageLayout old_layout,
   }
   return properties;
 }
-void transition_image_layout(const vk::Device &device,
-                             const vk::CommandPool &command_pool,
-                             const uint32_t queue_index,
-                             const vk::ImageLayout old_layout,
-                             const vk::ImageLayout new_layout,
-                             const vk::Image &image) {
-  vk::UniqueCommandBuffer command_buffer = begin_command(device, command_pool);
-
+void record_transition_image_layout(const vk::CommandBuffer &command_buffer,
+                                    const vk::ImageLayout old_layout,
+                                    const vk::ImageLayout new_layout,
+                                    const vk::Image &image,
+                                    const uint32_t mip_level_count) {
   vk::ImageMemoryBarrier barrier;
   barrier.oldLayout = old_layout;
   barrier.newLayout = new_layout;
@@ -863,7 +3220,7 @@ void transition_image_layout(const vk::Device &device,
       new_layout == vk::ImageLayout::eDepthStencilAttachmentOptimal
           ? vk::ImageAspectFlagBits::eDepth
           : vk::ImageAspectFlagBits::eColor;
-  subresource.levelCount = 1;
+  subresource.levelCount = mip_level_count;
   subresource.layerCount = 1;
   barrier.subresourceRange = subresource;
 
@@ -873,17 +3230,253 @@ void transition_image_layout(const vk::Device &device,
   barrier.srcAccessMask = transition_properties.source_mask;
   barrier.dstAccessMask = transition_properties.destination_mask;
 
-  (*command_buffer)
-      .pipelineBarrier(transition_properties.source_stage,
-                       transition_properties.destination_stage,
-                       vk::DependencyFlags(), {}, {}, {barrier});
+  command_buffer.pipelineBarrier(transition_properties.source_stage,
+                                 transition_properties.destination_stage,
+                                 vk::DependencyFlags(), {}, {}, {barrier});
+}
+void record_generate_mipmaps(const vk::CommandBuffer &command_buffer,
+                             const vk::Image &image, const uint32_t width,
+                             const uint32_t height,
+                             const uint32_t mip_level_count) {
+  vk::ImageMemoryBarrier barrier;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  int32_t level_width = static_cast<int32_t>(width);
+  int32_t level_height = static_cast<int32_t>(height);
+  for (uint32_t i = 1; i < mip_level_count; ++i) {
+    barrier.subresourceRange.baseMipLevel = i - 1;
+    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                   vk::PipelineStageFlagBits::eTransfer,
+                                   vk::DependencyFlags(), {}, {}, {barrier});
+
+    vk::ImageBlit blit;
+    blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    blit.srcSubresource.mipLevel = i - 1;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1] = vk::Offset3D(level_width, level_height, 1);
+    level_width = std::max(level_width / 2, 1);
+    level_height = std::max(level_height / 2, 1);
+    blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    blit.dstSubresource.mipLevel = i;
+    blit.dstSubresource.layerCount = 1;
+    blit.dstOffsets[1] = vk::Offset3D(level_width, level_height, 1);
+    command_buffer.blitImage(image, vk::ImageLayout::eTransferSrcOptimal,
+                             image, vk::ImageLayout::eTransferDstOptimal,
+                             {blit}, vk::Filter::eLinear);
+
+    barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                   vk::PipelineStageFlagBits::eFragmentShader,
+                                   vk::DependencyFlags(), {}, {}, {barrier});
+  }
 
+  barrier.subresourceRange.baseMipLevel = mip_level_count - 1;
+  barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+  barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+  barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+  barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+  command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                 vk::PipelineStageFlagBits::eFragmentShader,
+                                 vk::DependencyFlags(), {}, {}, {barrier});
+}
+void transition_image_layout(const vk::Device &device,
+                             const vk::CommandPool &command_pool,
+                             const uint32_t queue_index,
+                             const vk::ImageLayout old_layout,
+                             const vk::ImageLayout new_layout,
+                             const vk::Image &image) {
+  vk::UniqueCommandBuffer command_buffer = begin_command(device, command_pool);
+  record_transition_image_layout(*command_buffer, old_layout, new_layout,
+                                 image, 1);
   end_command(device, std::move(command_buffer), queue_index);
 }
+void UploadContext::initialize(const vk::Device &device,
+                               const uint32_t queue_index,
+                               MemoryAllocator &allocator) {
+  device_ = device;
+  queue_ = device.getQueue(queue_index, 0);
+  allocator_ = &allocator;
+  command_pool_ = create_command_pool(device, queue_index);
+}
+void UploadContext::set_timestamp_queries(const vk::QueryPool &query_pool,
+                                          const uint32_t first_query,
+                                          const uint32_t query_count,
+                                          const float timestamp_period,
+                                          const uint32_t timestamp_valid_bits) {
+  query_pool_ = query_pool;
+  first_query_ = first_query;
+  query_count_ = query_count;
+  next_query_ = 0;
+  timestamp_period_ = timestamp_period;
+  timestamp_valid_bits_ = timestamp_valid_bits;
+}
+double UploadContext::get_upload_time() const { return upload_time_; }
+vk::CommandBuffer UploadContext::get_command_buffer() {
+  if (!recording_batch_) {
+    recording_batch_.reset(new UploadBatch());
+    recording_batch_->command_buffer = begin_command(device_, *command_pool_);
+    recording_batch_->is_finished = create_fence(device_, false);
+    if (query_pool_) {
+      const uint32_t query = first_query_ + next_query_;
+      const auto owner = std::find_if(
+          pending_batches_.begin(), pending_batches_.end(),
+          [query](const std::unique_ptr<UploadBatch> &batch) {
+            return batch->query == query;
+          });
+      if (owner != pending_batches_.end()) {
+        const vk::Fence is_finished = *(*owner)->is_finished;
+        device_.waitForFences(is_finished, VK_TRUE, UINT64_MAX);
+        poll();
+      }
+      recording_batch_->query = query;
+      next_query_ = (next_query_ + 2) % query_count_;
+      record_timestamp_begin(*recording_batch_->command_buffer, query_pool_,
+                             recording_batch_->query);
+    }
+  }
+  return *recording_batch_->command_buffer;
+}
+vk::Buffer UploadContext::create_staging_buffer(const vk::DeviceSize size,
+                                                void *&data) {
+  vk::UniqueBuffer staging_buffer =
+      create_buffer(device_, size, vk::BufferUsageFlagBits::eTransferSrc);
+
+  MemoryAllocation staging_memory = allocate_buffer_memory(
+      device_, *staging_buffer, *allocator_,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "staging_buffer");
+
+  device_.bindBufferMemory(*staging_buffer, staging_memory.memory,
+                           staging_memory.offset);
+
+  data = staging_memory.data;
+
+  const vk::Buffer buffer = *staging_buffer;
+  get_command_buffer();
+  recording_batch_->staging_buffers.push_back(std::move(staging_buffer));
+  recording_batch_->staging_memories.push_back(staging_memory);
+  return buffer;
+}
+void UploadContext::upload_buffer(const void *data, const vk::DeviceSize size,
+                                  const vk::Buffer &destination_buffer) {
+  void *staging_data = nullptr;
+  const vk::Buffer staging_buffer = create_staging_buffer(size, staging_data);
+  std::memcpy(staging_data, data, size);
+  record_copy_buffer_to_buffer(get_command_buffer(), staging_buffer,
+                               destination_buffer, size);
+}
+void UploadContext::upload_image(const std::vector<ImageLevel> &levels,
+                                 const vk::Image &destination_image,
+                                 const uint32_t mip_level_count) {
+  std::vector<vk::BufferImageCopy> regions(levels.size());
+  vk::DeviceSize size = 0;
+  for (size_t i = 0; i < levels.size(); ++i) {
+    regions[i].bufferOffset = size;
+    regions[i].imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    regions[i].imageSubresource.mipLevel = static_cast<uint32_t>(i);
+    regions[i].imageSubresource.layerCount = 1;
+    regions[i].imageExtent =
+        vk::Extent3D(levels[i].width, levels[i].height, 1);
+    size = align_size(size + levels[i].size, 16);
+  }
+
+  void *staging_data = nullptr;
+  const vk::Buffer staging_buffer = create_staging_buffer(size, staging_data);
+  for (size_t i = 0; i < levels.size(); ++i) {
+    std::memcpy(static_cast<uint8_t *>(staging_data) + regions[i].bufferOffset,
+                levels[i].data, levels[i].size);
+  }
+
+  const vk::CommandBuffer command_buffer = get_command_buffer();
+  record_transition_image_layout(command_buffer, vk::ImageLayout::eUndefined,
+                                 vk::ImageLayout::eTransferDstOptimal,
+                                 destination_image, mip_level_count);
+  command_buffer.copyBufferToImage(staging_buffer, destination_image,
+                                   vk::ImageLayout::eTransferDstOptimal,
+                                   regions);
+  if (levels.size() < mip_level_count) {
+    record_generate_mipmaps(command_buffer, destination_image,
+                            levels[0].width, levels[0].height,
+                            mip_level_count);
+  } else {
+    record_transition_image_layout(command_buffer,
+                                   vk::ImageLayout::eTransferDstOptimal,
+                                   vk::ImageLayout::eShaderReadOnlyOptimal,
+                                   destination_image, mip_level_count);
+  }
+}
+void UploadContext::submit() {
+  VKA_PROFILE_ZONE("UploadContext::submit");
+  if (!recording_batch_) {
+    return;
+  }
+  if (recording_batch_->query != UINT32_MAX) {
+    record_timestamp_end(*recording_batch_->command_buffer, query_pool_,
+                         recording_batch_->query);
+  }
+  (*recording_batch_->command_buffer).end();
+
+  vk::SubmitInfo submit_info;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &(*recording_batch_->command_buffer);
+  queue_.submit(submit_info, *recording_batch_->is_finished);
+
+  pending_batches_.push_back(std::move(recording_batch_));
+}
+bool UploadContext::poll() {
+  VKA_PROFILE_ZONE("UploadContext::poll");
+  for (auto it = pending_batches_.begin(); it != pending_batches_.end();) {
+    if (device_.getFenceStatus(*(*it)->is_finished) != vk::Result::eSuccess) {
+      ++it;
+      continue;
+    }
+    std::vector<uint64_t> timestamps;
+    if ((*it)->query != UINT32_MAX &&
+        read_timestamps(device_, query_pool_, (*it)->query, 2, timestamps)) {
+      upload_time_ = get_timestamp_milliseconds(
+          timestamps[0], timestamps[1], timestamp_period_,
+          timestamp_valid_bits_);
+    }
+    for (auto &staging_memory : (*it)->staging_memories) {
+      allocator_->free(staging_memory);
+    }
+    it = pending_batches_.erase(it);
+  }
+  return pending_batches_.empty();
+}
+void UploadContext::wait() {
+  VKA_PROFILE_ZONE("UploadContext::wait");
+  for (const auto &batch : pending_batches_) {
+    const vk::Fence is_finished = *batch->is_finished;
+    device_.waitForFences(is_finished, VK_TRUE, UINT64_MAX);
+  }
+  poll();
+}
+void UploadContext::release() {
+  if (!command_pool_) {
+    return;
+  }
+  submit();
+  wait();
+  command_pool_.reset();
+}
 vk::UniqueImageView create_texture_image_view(const vk::Device &device,
-                                              const vk::Image &image) {
-  return create_image_view(device, image, vk::Format::eR8G8B8A8Unorm,
-                           vk::ImageAspectFlagBits::eColor);
+                                              const vk::Image &image,
+                                              const vk::Format format,
+                                              const uint32_t mip_level_count) {
+  return create_image_view(device, image, format,
+                           vk::ImageAspectFlagBits::eColor, mip_level_count);
 }
 vk::UniqueSampler create_texture_sampler(const vk::Device &device) {
   vk::SamplerCreateInfo info;
@@ -894,23 +3487,69 @@ vk::UniqueSampler create_texture_sampler(const vk::Device &device) {
   info.borderColor = vk::BorderColor::eIntOpaqueBlack;
   info.compareOp = vk::CompareOp::eAlways;
   info.mipmapMode = vk::SamplerMipmapMode::eLinear;
+  info.maxLod = VK_LOD_CLAMP_NONE;
   return device.createSamplerUnique(info);
 }
-VulkanController::VulkanController() {}
-VulkanController::~VulkanController() {
-  if (device_) {
-    (*device_).waitIdle();
+bool is_linear_blit_supported(const vk::PhysicalDevice &physical_device,
+                              const vk::Format format) {
+  const vk::FormatFeatureFlags features =
+      vk::FormatFeatureFlagBits::eBlitSrc |
+      vk::FormatFeatureFlagBits::eBlitDst |
+      vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+  const vk::FormatProperties properties =
+      physical_device.getFormatProperties(format);
+  return (properties.optimalTilingFeatures & features) == features;
+}
+bool is_texture_format_supported(const vk::PhysicalDevice &physical_device,
+                                 const vk::Format format) {
+  const vk::FormatProperties properties =
+      physical_device.getFormatProperties(format);
+  const vk::FormatFeatureFlags required_features =
+      vk::FormatFeatureFlagBits::eSampledImage |
+      vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+  return (properties.optimalTilingFeatures & required_features) ==
+         required_features;
+}
+double get_percentile(const std::vector<double> &sorted_samples,
+                      const double percentile) {
+  if (sorted_samples.empty()) {
+    return 0.0;
   }
-  release();
+  const double sample_count = static_cast<double>(sorted_samples.size());
+  const double rank = std::ceil(percentile / 100.0 * sample_count);
+  const size_t index = static_cast<size_t>(std::max(rank, 1.0)) - 1;
+  return sorted_samples[std::min(index, sorted_samples.size() - 1)];
+}
+FrameTimeStatistics
+compute_frame_time_statistics(std::vector<double> frame_times) {
+  FrameTimeStatistics statistics = {};
+  if (frame_times.empty()) {
+    return statistics;
+  }
+  std::sort(frame_times.begin(), frame_times.end());
+  statistics.mean =
+      std::accumulate(frame_times.begin(), frame_times.end(), 0.0) /
+      static_cast<double>(frame_times.size());
+  statistics.p50 = get_percentile(frame_times, 50.0);
+  statistics.p95 = get_percentile(frame_times, 95.0);
+  statistics.p99 = get_percentile(frame_times, 99.0);
+  statistics.max = frame_times.back();
+  return statistics;
 }
+VulkanController::VulkanController(const ControllerSettings &settings)
+    : settings_(settings), current_frame_(0), is_pipeline_cache_warm_(false),
+      is_memory_budget_enabled_(false), is_offscreen_image_rendered_(false),
+      recording_time_(0.0), culling_time_(0.0), gpu_time_(0.0),
+      timestamp_period_(1.0f), timestamp_valid_bits_(0),
+      pipeline_statistics_(), startup_timings_(),
+      mesh_bounds_(), dequantization_(1.0f),
+      index_type_(vk::IndexType::eUint32) {}
+VulkanController::~VulkanController() { release(); }
 void VulkanController::initialize(vk::UniqueInstance instance,
                                   vk::UniqueSurfaceKHR surface,
                                   const vk::Extent2D swapchain_extent) {
-  texture_ = vka::Texture("chalet.jpg");
-  vka::Model model("chalet.obj");
-  vertices_ = model.vertices;
-  indices_ = model.indices;
-
+  VKA_PROFILE_ZONE("VulkanController::initialize");
+  startup_time_ = std::chrono::high_resolution_clock::now();
   instance_ = std::move(instance);
   surface_ = std::move(surface);
   swapchain_extent_ = swapchain_extent;
@@ -918,6 +3557,7 @@ void VulkanController::initialize(vk::UniqueInstance instance,
   const std::vector<vk::PhysicalDevice> devices =
       (*instance_).enumeratePhysicalDevices();
   physical_device_ = vka::select_physical_device(devices);
+  load_assets();
 
   const std::vector<vk::SurfaceFormatKHR> formats =
       physical_device_.getSurfaceFormatsKHR(*surface_);
@@ -933,54 +3573,347 @@ void VulkanController::initialize(vk::UniqueInstance instance,
   queue_index_ = vka::find_graphics_and_presentation_queue_family_index(
       queue_family_properties, presentation_support);
 
-  device_ = vka::create_device(physical_device_, queue_index_);
+  std::vector<const char *> extension_names = {
+      VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  add_memory_budget_extension(extension_names);
+  device_ = vka::create_device(physical_device_, queue_index_, extension_names);
+  startup_timings_.device_creation = vka::get_elapsed_milliseconds(
+      startup_time_, std::chrono::high_resolution_clock::now());
 
-  command_pool_ = vka::create_command_pool(*device_, queue_index_);
+  initialize_resources();
+}
+void VulkanController::initialize(vk::UniqueInstance instance,
+                                  const vk::Extent2D extent) {
+  VKA_PROFILE_ZONE("VulkanController::initialize");
+  startup_time_ = std::chrono::high_resolution_clock::now();
+  instance_ = std::move(instance);
+  swapchain_extent_ = extent;
 
-  create_uniform_buffer();
-  create_vertex_buffer();
-  create_index_buffer();
-  create_texture_image();
+  const std::vector<vk::PhysicalDevice> devices =
+      (*instance_).enumeratePhysicalDevices();
+  physical_device_ = vka::select_physical_device(devices);
+  load_assets();
 
-  texture_sampler_ = vka::create_texture_sampler(*device_);
+  surface_format_ = {vk::Format::eR8G8B8A8Unorm,
+                     vk::ColorSpaceKHR::eSrgbNonlinear};
 
-  descriptor_pool_ = vka::create_descriptor_pool(*device_);
-  descriptor_set_layout_ = vka::create_descriptor_set_layout(*device_);
-  descriptor_sets_ = vka::create_descriptor_sets(*device_, *descriptor_pool_,
-                                                 *descriptor_set_layout_);
+  const std::vector<vk::QueueFamilyProperties> queue_family_properties =
+      physical_device_.getQueueFamilyProperties();
 
-  std::vector<vk::DescriptorSet> descriptor_set_pointers;
-  for (const auto &descriptor_set : descriptor_sets_) {
-    descriptor_set_pointers.push_back(*descriptor_set);
+  queue_index_ = vka::find_graphics_queue_family_index(queue_family_properties);
+
+  std::vector<const char *> extension_names;
+  add_memory_budget_extension(extension_names);
+  device_ = vka::create_device(physical_device_, queue_index_, extension_names);
+  startup_timings_.device_creation = vka::get_elapsed_milliseconds(
+      startup_time_, std::chrono::high_resolution_clock::now());
+
+  initialize_resources();
+}
+void VulkanController::load_assets() {
+  VKA_PROFILE_ZONE("VulkanController::load_assets");
+  mesh_asset_ = std::async(std::launch::async, [this]() {
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<vka::MeshAsset> asset =
+        vka::load_mesh_asset("chalet.obj", settings_.vertex_layout);
+    startup_timings_.mesh_loading = vka::get_elapsed_milliseconds(
+        start_time, std::chrono::high_resolution_clock::now());
+    return asset;
+  });
+  const vk::PhysicalDevice physical_device = physical_device_;
+  texture_asset_ = std::async(std::launch::async, [this, physical_device]() {
+    const auto start_time = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<vka::TextureAsset> asset = vka::load_texture_asset(
+        physical_device,
+        {"chalet_bc7.ktx", "chalet_bc3.ktx", "chalet_bc1.ktx", "chalet.ktx"},
+        "chalet.jpg");
+    startup_timings_.texture_loading = vka::get_elapsed_milliseconds(
+        start_time, std::chrono::high_resolution_clock::now());
+    return asset;
+  });
+}
+void VulkanController::add_memory_budget_extension(
+    std::vector<const char *> &extension_names) {
+#ifdef VK_EXT_memory_budget
+  is_memory_budget_enabled_ = vka::is_extension_available(
+      physical_device_.enumerateDeviceExtensionProperties(),
+      VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (is_memory_budget_enabled_) {
+    extension_names.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
   }
+#endif
+}
+void VulkanController::initialize_resources() {
+  VKA_PROFILE_ZONE("VulkanController::initialize_resources");
+  auto start_time = std::chrono::high_resolution_clock::now();
+  memory_allocator_.initialize(*device_, physical_device_,
+                               settings_.memory_block_size);
 
-  vka::update_descriptor_sets(*device_, descriptor_set_pointers,
-                              *uniform_buffer_, *texture_image_view_,
-                              *texture_sampler_);
+  upload_context_.initialize(*device_, queue_index_, memory_allocator_);
+  create_timestamp_query_pool();
+  create_pipeline_statistics_query_pool();
+
+  texture_sampler_ = vka::create_texture_sampler(*device_);
+
+  descriptor_allocator_.initialize(*device_, vka::get_descriptor_set_sizes(),
+                                   64, settings_.frames_in_flight);
+  descriptor_set_layout_ = vka::create_descriptor_set_layout(*device_);
+
+  create_uniform_buffer();
+  load_pipeline_cache();
+  create_pipeline();
+  startup_timings_.pipeline_creation = vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
+
+  start_time = std::chrono::high_resolution_clock::now();
+  const std::unique_ptr<vka::MeshAsset> mesh_asset = mesh_asset_.get();
+  const std::unique_ptr<vka::TextureAsset> texture_asset =
+      texture_asset_.get();
+  startup_timings_.asset_wait = vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
+
+  start_time = std::chrono::high_resolution_clock::now();
+  index_type_ = mesh_asset->mesh.index_type;
+  submeshes_ = vka::get_submeshes(mesh_asset->mesh);
+  mesh_bounds_ = mesh_asset->bounds;
+  dequantization_ = mesh_asset->dequantization;
+  create_vertex_buffer(*mesh_asset);
+  create_index_buffer(mesh_asset->mesh);
+  create_instance_buffer();
+  create_texture_image(*texture_asset);
+  upload_context_.submit();
+  create_frames();
 
   recreate_swapchain(swapchain_extent_);
+  startup_timings_.upload = vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
+  startup_timings_.total = vka::get_elapsed_milliseconds(
+      startup_time_, std::chrono::high_resolution_clock::now());
 }
-void VulkanController::create_uniform_buffer() {
-  const uint32_t ubo_size =
-      static_cast<uint32_t>(sizeof(vka::UniformBufferObject));
+StartupTimings VulkanController::get_startup_timings() const {
+  return startup_timings_;
+}
+double VulkanController::get_recording_time() const { return recording_time_; }
+double VulkanController::get_culling_time() const { return culling_time_; }
+bool VulkanController::is_gpu_timing_supported() const {
+  return static_cast<bool>(timestamp_query_pool_);
+}
+double VulkanController::get_gpu_time() const { return gpu_time_; }
+double VulkanController::get_upload_time() const {
+  return upload_context_.get_upload_time();
+}
+bool VulkanController::is_pipeline_statistics_supported() const {
+  return static_cast<bool>(pipeline_statistics_query_pool_);
+}
+PipelineStatistics VulkanController::get_pipeline_statistics() const {
+  return pipeline_statistics_;
+}
+void VulkanController::create_timestamp_query_pool() {
+  timestamp_valid_bits_ =
+      physical_device_.getQueueFamilyProperties()[queue_index_]
+          .timestampValidBits;
+  timestamp_period_ = physical_device_.getProperties().limits.timestampPeriod;
+  if (timestamp_valid_bits_ == 0) {
+    return;
+  }
 
-  uniform_buffer_ = vka::create_buffer(*device_, ubo_size,
-                                       vk::BufferUsageFlagBits::eUniformBuffer);
+  const uint32_t frame_query_count = 2 * settings_.frames_in_flight;
+  const uint32_t upload_query_count = 16;
+  timestamp_query_pool_ = vka::create_timestamp_query_pool(
+      *device_, frame_query_count + upload_query_count);
+  upload_context_.set_timestamp_queries(
+      *timestamp_query_pool_, frame_query_count, upload_query_count,
+      timestamp_period_, timestamp_valid_bits_);
+}
+void VulkanController::create_pipeline_statistics_query_pool() {
+  const vk::PhysicalDeviceFeatures features = physical_device_.getFeatures();
+  if (!settings_.is_pipeline_statistics_enabled ||
+      !features.pipelineStatisticsQuery) {
+    return;
+  }
+  if (settings_.recording_thread_count > 1 && !features.inheritedQueries) {
+    return;
+  }
+  pipeline_statistics_query_pool_ = vka::create_pipeline_statistics_query_pool(
+      *device_, settings_.frames_in_flight);
+}
+void VulkanController::load_pipeline_cache() {
+  VKA_PROFILE_ZONE("VulkanController::load_pipeline_cache");
+  std::vector<char> data;
+  if (!settings_.pipeline_cache_file_name.empty()) {
+    data = vka::read_file(settings_.pipeline_cache_file_name);
+  }
+  is_pipeline_cache_warm_ =
+      vka::is_pipeline_cache_valid(data, physical_device_.getProperties());
+  if (!is_pipeline_cache_warm_) {
+    data.clear();
+  }
+  pipeline_cache_ = vka::create_pipeline_cache(*device_, data);
+}
+void VulkanController::create_pipeline() {
+  VKA_PROFILE_ZONE("VulkanController::create_pipeline");
+  render_pass_ = vka::create_render_pass(
+      *device_, surface_format_.format,
+      surface_ ? vk::ImageLayout::ePresentSrcKHR
+               : vk::ImageLayout::eTransferSrcOptimal);
 
-  uniform_buffer_memory_ = vka::allocate_buffer_memory(
-      *device_, *uniform_buffer_, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eHostVisible |
-          vk::MemoryPropertyFlagBits::eHostCoherent);
+  pipeline_layout_ = vka::create_pipeline_layout(
+      *device_, *descriptor_set_layout_, settings_.transform_mode);
 
-  (*device_).bindBufferMemory(*uniform_buffer_, *uniform_buffer_memory_, 0);
+  graphics_pipeline_ = vka::create_graphics_pipeline(
+      *device_, *render_pass_, *pipeline_layout_, *pipeline_cache_,
+      settings_.vertex_layout, settings_.transform_mode);
+}
+bool VulkanController::is_pipeline_cache_warm() const {
+  return is_pipeline_cache_warm_;
+}
+void VulkanController::save_pipeline_cache() {
+  if (!pipeline_cache_ || settings_.pipeline_cache_file_name.empty()) {
+    return;
+  }
+  vka::write_file(settings_.pipeline_cache_file_name,
+                  vka::get_pipeline_cache_data(*device_, *pipeline_cache_));
+}
+void VulkanController::create_frames() {
+  VKA_PROFILE_ZONE("VulkanController::create_frames");
+  frames_.resize(settings_.frames_in_flight);
+  for (auto &frame : frames_) {
+    frame.command_pool = vka::create_command_pool(*device_, queue_index_);
+    std::vector<vk::UniqueCommandBuffer> command_buffers =
+        vka::create_command_buffers(*device_, *frame.command_pool, 1);
+    frame.command_buffer = std::move(command_buffers[0]);
+
+    const uint32_t secondary_count = settings_.recording_thread_count > 1
+                                         ? settings_.recording_thread_count
+                                         : 0;
+    frame.secondary_command_buffers.clear();
+    frame.secondary_command_pools.clear();
+    for (uint32_t i = 0; i < secondary_count; ++i) {
+      frame.secondary_command_pools.push_back(
+          vka::create_command_pool(*device_, queue_index_));
+      std::vector<vk::UniqueCommandBuffer> secondary_command_buffers =
+          vka::create_secondary_command_buffers(
+              *device_, *frame.secondary_command_pools.back(), 1);
+      frame.secondary_command_buffers.push_back(
+          std::move(secondary_command_buffers[0]));
+    }
 
-  vka::fill_buffer(*device_, *uniform_buffer_memory_,
-                   vka::UniformBufferObject());
+    frame.is_frame_finished = vka::create_fence(*device_, true);
+    frame.is_image_available = vka::create_semaphore(*device_);
+    frame.is_rendering_finished = vka::create_semaphore(*device_);
+  }
+  current_frame_ = 0;
+  recording_threads_.initialize(settings_.recording_thread_count);
+}
+void VulkanController::wait_for_frame() {
+  VKA_PROFILE_ZONE("VulkanController::wait_for_frame");
+  const vk::Fence is_frame_finished =
+      *frames_[current_frame_].is_frame_finished;
+  (*device_).waitForFences(is_frame_finished, VK_TRUE, UINT64_MAX);
+  upload_context_.poll();
+
+  FrameResources &frame = frames_[current_frame_];
+  std::vector<uint64_t> timestamps;
+  if (frame.has_timestamps &&
+      vka::read_timestamps(*device_, *timestamp_query_pool_,
+                           2 * current_frame_, 2, timestamps)) {
+    gpu_time_ = vka::get_timestamp_milliseconds(
+        timestamps[0], timestamps[1], timestamp_period_,
+        timestamp_valid_bits_);
+    frame.has_timestamps = false;
+  }
+  if (frame.has_pipeline_statistics &&
+      vka::read_pipeline_statistics(*device_, *pipeline_statistics_query_pool_,
+                                    current_frame_, pipeline_statistics_)) {
+    frame.has_pipeline_statistics = false;
+  }
+}
+void VulkanController::record_frame(FrameResources &frame,
+                                    const vk::Framebuffer &framebuffer) {
+  VKA_PROFILE_ZONE("VulkanController::record_frame");
+  const auto start_time = std::chrono::high_resolution_clock::now();
+  const vk::Buffer instance_buffer = settings_.is_culling_enabled
+                                         ? *visible_instance_buffer_
+                                         : *instance_buffer_;
+  (*device_).resetCommandPool(*frame.command_pool, vk::CommandPoolResetFlags());
+  descriptor_allocator_.begin_frame(current_frame_);
+  const vk::DescriptorSet descriptor_set =
+      descriptor_allocator_.allocate(*descriptor_set_layout_, 1)[0];
+  vka::update_descriptor_sets(*device_, {descriptor_set},
+                              *uniform_buffer_.buffer, *texture_image_view_,
+                              *texture_sampler_);
+  if (frame.secondary_command_buffers.empty()) {
+    vka::record_command_buffers(
+        *device_, {*frame.command_buffer}, *render_pass_, *graphics_pipeline_,
+        *pipeline_layout_, {framebuffer}, swapchain_extent_, *vertex_buffer_,
+        instance_buffer, *index_buffer_, index_type_, submeshes_,
+        {descriptor_set}, draw_commands_, settings_.transform_mode,
+        object_models_, *timestamp_query_pool_, 2 * current_frame_,
+        *pipeline_statistics_query_pool_, current_frame_);
+  } else {
+    const uint32_t thread_count =
+        static_cast<uint32_t>(frame.secondary_command_buffers.size());
+    const uint32_t objects_per_thread =
+        (settings_.object_count + thread_count - 1) / thread_count;
+    const vk::QueryPipelineStatisticFlags pipeline_statistics =
+        pipeline_statistics_query_pool_ ? vka::get_pipeline_statistic_flags()
+                                        : vk::QueryPipelineStatisticFlags();
+    recording_threads_.run([&](const size_t thread_index) {
+      const uint32_t first_object =
+          std::min(objects_per_thread * static_cast<uint32_t>(thread_index),
+                   settings_.object_count);
+      const uint32_t last_object =
+          std::min(first_object + objects_per_thread, settings_.object_count);
+      (*device_).resetCommandPool(*frame.secondary_command_pools[thread_index],
+                                  vk::CommandPoolResetFlags());
+      const std::vector<glm::mat4> object_models =
+          object_models_.empty()
+              ? std::vector<glm::mat4>()
+              : std::vector<glm::mat4>(object_models_.begin() + first_object,
+                                       object_models_.begin() + last_object);
+      vka::record_secondary_command_buffer(
+          *frame.secondary_command_buffers[thread_index], *render_pass_,
+          framebuffer, *graphics_pipeline_, *pipeline_layout_,
+          swapchain_extent_, *vertex_buffer_, instance_buffer, *index_buffer_,
+          index_type_, submeshes_, {descriptor_set},
+          std::vector<vka::DrawCommand>(draw_commands_.begin() + first_object,
+                                        draw_commands_.begin() + last_object),
+          settings_.transform_mode, object_models, pipeline_statistics);
+    });
+
+    std::vector<vk::CommandBuffer> secondary_command_buffers;
+    for (const auto &command_buffer : frame.secondary_command_buffers) {
+      secondary_command_buffers.push_back(*command_buffer);
+    }
+    vka::record_primary_command_buffer(
+        *frame.command_buffer, *render_pass_, framebuffer, swapchain_extent_,
+        secondary_command_buffers, *timestamp_query_pool_, 2 * current_frame_,
+        *pipeline_statistics_query_pool_, current_frame_);
+  }
+  recording_time_ = vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
+}
+void VulkanController::create_uniform_buffer() {
+  const bool is_push_constants_enabled =
+      settings_.transform_mode == vka::TransformMode::push_constants;
+  uniform_buffer_ = vka::create_uniform_ring_buffer(
+      *device_, memory_allocator_,
+      physical_device_.getProperties().limits.minUniformBufferOffsetAlignment,
+      sizeof(vka::UniformBufferObject),
+      is_push_constants_enabled ? 1 : settings_.frames_in_flight,
+      is_push_constants_enabled ? 1 : settings_.object_count);
+  uniform_extent_ = vk::Extent2D();
 }
 void VulkanController::update_uniform_buffer(const float delta_time) {
+  VKA_PROFILE_ZONE("VulkanController::update_uniform_buffer");
+  const uint32_t grid_size = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<float>(settings_.object_count))));
+  const float cell_size = 2.0f / grid_size;
+  const glm::mat4 rotation =
+      glm::rotate(glm::mat4(1.0f), delta_time * glm::radians(90.0f),
+                  glm::vec3(0.0f, 0.0f, 1.0f));
+
   vka::UniformBufferObject ubo;
-  ubo.model = glm::rotate(glm::mat4(1.0f), delta_time * glm::radians(90.0f),
-                          glm::vec3(0.0f, 0.0f, 1.0f));
   ubo.view =
       glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f),
                   glm::vec3(0.0f, 0.0f, 1.0f));
@@ -989,258 +3922,489 @@ void VulkanController::update_uniform_buffer(const float delta_time) {
       swapchain_extent_.width / static_cast<float>(swapchain_extent_.height),
       0.1f, 10.0f);
   ubo.projection[1][1] *= -1;
-  vka::fill_buffer(*device_, *uniform_buffer_memory_, ubo);
+
+  const bool is_push_constants_enabled =
+      settings_.transform_mode == vka::TransformMode::push_constants;
+  if (is_push_constants_enabled && uniform_extent_ != swapchain_extent_) {
+    std::memcpy(uniform_buffer_.data, &ubo.view, 2 * sizeof(glm::mat4));
+    uniform_extent_ = swapchain_extent_;
+  }
+
+  VKA_PROFILE_ZONE("VulkanController::update_uniform_buffer::objects");
+  culling_time_ = 0.0;
+  for (uint32_t i = 0; i < settings_.object_count; ++i) {
+    const glm::vec3 position(
+        ((i % grid_size) + 0.5f) * cell_size - 1.0f,
+        ((i / grid_size) + 0.5f) * cell_size - 1.0f, 0.0f);
+    ubo.model = glm::translate(glm::mat4(1.0f), position) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(cell_size / 2.0f)) *
+                rotation;
+    if (is_push_constants_enabled) {
+      object_models_[i] = ubo.model;
+    } else {
+      std::memcpy(uniform_buffer_.data +
+                      vka::get_uniform_slice_offset(uniform_buffer_,
+                                                    current_frame_, i),
+                  &ubo, sizeof(ubo));
+    }
+    cull_object(ubo.projection * ubo.view * ubo.model, i);
+  }
+}
+void VulkanController::cull_object(const glm::mat4 &matrix,
+                                   const uint32_t object_index) {
+  const uint32_t dynamic_offset =
+      settings_.transform_mode == vka::TransformMode::push_constants
+          ? 0
+          : vka::get_uniform_slice_offset(uniform_buffer_, current_frame_,
+                                          object_index);
+  if (!settings_.is_culling_enabled) {
+    draw_commands_[object_index] = {dynamic_offset, settings_.instance_count,
+                                    0};
+    return;
+  }
+
+  const auto start_time = std::chrono::high_resolution_clock::now();
+  vka::cull_instances(vka::extract_frustum(matrix), instance_bounds_,
+                      visible_instances_);
+  const uint32_t first_instance = static_cast<uint32_t>(
+      (static_cast<vk::DeviceSize>(current_frame_) * settings_.object_count +
+       object_index) *
+      settings_.instance_count);
+  vka::InstanceData *instances =
+      reinterpret_cast<vka::InstanceData *>(
+          visible_instance_buffer_memory_.data) +
+      first_instance;
+  for (size_t i = 0; i < visible_instances_.size(); ++i) {
+    instances[i] = instances_[visible_instances_[i]];
+  }
+  draw_commands_[object_index] = {
+      dynamic_offset, static_cast<uint32_t>(visible_instances_.size()),
+      first_instance};
+  culling_time_ += vka::get_elapsed_milliseconds(
+      start_time, std::chrono::high_resolution_clock::now());
 }
-void VulkanController::create_vertex_buffer() {
-  const uint32_t vertices_size =
-      static_cast<uint32_t>(sizeof(vertices_[0]) * vertices_.size());
+void VulkanController::create_vertex_buffer(const vka::MeshAsset &asset) {
+  VKA_PROFILE_ZONE("VulkanController::create_vertex_buffer");
+  const void *vertex_data = asset.vertex_data.data();
+  uint32_t vertices_size = static_cast<uint32_t>(asset.vertex_data.size());
+  if (asset.vertex_data.empty()) {
+    vertex_data = asset.mesh.vertices;
+    vertices_size =
+        static_cast<uint32_t>(sizeof(vka::Vertex) * asset.mesh.vertex_count);
+  }
 
   vertex_buffer_ = vka::create_buffer(
       *device_, vertices_size, vk::BufferUsageFlagBits::eVertexBuffer |
                                    vk::BufferUsageFlagBits::eTransferDst);
 
   vertex_buffer_memory_ = vka::allocate_buffer_memory(
-      *device_, *vertex_buffer_, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-  (*device_).bindBufferMemory(*vertex_buffer_, *vertex_buffer_memory_, 0);
-
-  vk::UniqueBuffer staging_buffer = vka::create_buffer(
-      *device_, vertices_size, vk::BufferUsageFlagBits::eTransferSrc);
-
-  vk::UniqueDeviceMemory staging_buffer_memory = vka::allocate_buffer_memory(
-      *device_, *staging_buffer, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eHostVisible |
-          vk::MemoryPropertyFlagBits::eHostCoherent);
-
-  (*device_).bindBufferMemory(*staging_buffer, *staging_buffer_memory, 0);
+      *device_, *vertex_buffer_, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, "vertex_buffer");
 
-  vka::fill_buffer(*device_, *staging_buffer_memory, vertices_);
+  (*device_).bindBufferMemory(*vertex_buffer_, vertex_buffer_memory_.memory,
+                              vertex_buffer_memory_.offset);
 
-  vka::copy_buffer_to_buffer(*device_, *staging_buffer, *vertex_buffer_,
-                             vertices_size, *command_pool_, queue_index_);
+  upload_context_.upload_buffer(vertex_data, vertices_size, *vertex_buffer_);
 }
-void VulkanController::create_index_buffer() {
+void VulkanController::create_index_buffer(const MeshView &mesh) {
+  VKA_PROFILE_ZONE("VulkanController::create_index_buffer");
   const uint32_t indices_size =
-      static_cast<uint32_t>(sizeof(indices_[0]) * indices_.size());
+      vka::get_index_size(mesh.index_type) * mesh.index_count;
 
   index_buffer_ = vka::create_buffer(*device_, indices_size,
                                      vk::BufferUsageFlagBits::eIndexBuffer |
                                          vk::BufferUsageFlagBits::eTransferDst);
 
   index_buffer_memory_ = vka::allocate_buffer_memory(
-      *device_, *index_buffer_, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eDeviceLocal);
+      *device_, *index_buffer_, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, "index_buffer");
 
-  (*device_).bindBufferMemory(*index_buffer_, *index_buffer_memory_, 0);
+  (*device_).bindBufferMemory(*index_buffer_, index_buffer_memory_.memory,
+                              index_buffer_memory_.offset);
 
-  vk::UniqueBuffer staging_buffer = vka::create_buffer(
-      *device_, indices_size, vk::BufferUsageFlagBits::eTransferSrc);
-
-  vk::UniqueDeviceMemory staging_buffer_memory = vka::allocate_buffer_memory(
-      *device_, *staging_buffer, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eHostVisible |
-          vk::MemoryPropertyFlagBits::eHostCoherent);
+  upload_context_.upload_buffer(mesh.indices, indices_size, *index_buffer_);
+}
+void VulkanController::create_instance_buffer() {
+  VKA_PROFILE_ZONE("VulkanController::create_instance_buffer");
+  const vk::DeviceSize visible_instance_count =
+      static_cast<vk::DeviceSize>(settings_.frames_in_flight) *
+      settings_.object_count * settings_.instance_count;
+  if (settings_.is_culling_enabled && visible_instance_count > UINT32_MAX) {
+    throw std::runtime_error("Too many instances to cull per frame");
+  }
+  instances_ = vka::get_instance_grid(settings_.instance_count);
+  instance_bounds_ = vka::get_instance_bounds(instances_, mesh_bounds_);
+  for (auto &instance : instances_) {
+    instance.model = instance.model * dequantization_;
+  }
+  draw_commands_.assign(settings_.object_count, {0, 0, 0});
+  object_models_.assign(
+      settings_.transform_mode == vka::TransformMode::push_constants
+          ? settings_.object_count
+          : 0,
+      glm::mat4(1.0f));
+  const vk::DeviceSize instances_size =
+      static_cast<vk::DeviceSize>(sizeof(vka::InstanceData)) *
+      instances_.size();
+
+  instance_buffer_ = vka::create_buffer(
+      *device_, instances_size, vk::BufferUsageFlagBits::eVertexBuffer |
+                                    vk::BufferUsageFlagBits::eTransferDst);
+
+  memory_allocator_.free(instance_buffer_memory_);
+  instance_buffer_memory_ = vka::allocate_buffer_memory(
+      *device_, *instance_buffer_, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, "instance_buffer");
+
+  (*device_).bindBufferMemory(*instance_buffer_,
+                              instance_buffer_memory_.memory,
+                              instance_buffer_memory_.offset);
+
+  upload_context_.upload_buffer(instances_.data(), instances_size,
+                                *instance_buffer_);
+
+  memory_allocator_.free(visible_instance_buffer_memory_);
+  visible_instance_buffer_.reset();
+  if (!settings_.is_culling_enabled) {
+    return;
+  }
 
-  (*device_).bindBufferMemory(*staging_buffer, *staging_buffer_memory, 0);
+  visible_instance_buffer_ = vka::create_buffer(
+      *device_, sizeof(vka::InstanceData) * visible_instance_count,
+      vk::BufferUsageFlagBits::eVertexBuffer);
 
-  vka::fill_buffer(*device_, *staging_buffer_memory, indices_);
+  visible_instance_buffer_memory_ = vka::allocate_buffer_memory(
+      *device_, *visible_instance_buffer_, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "visible_instance_buffer");
 
-  vka::copy_buffer_to_buffer(*device_, *staging_buffer, *index_buffer_,
-                             indices_size, *command_pool_, queue_index_);
+  (*device_).bindBufferMemory(*visible_instance_buffer_,
+                              visible_instance_buffer_memory_.memory,
+                              visible_instance_buffer_memory_.offset);
+}
+void VulkanController::set_instance_count(const uint32_t instance_count) {
+  (*device_).waitIdle();
+  settings_.instance_count = instance_count;
+  create_instance_buffer();
+  upload_context_.submit();
+  upload_context_.wait();
 }
-void VulkanController::create_texture_image() {
+void VulkanController::create_texture_image(const TextureAsset &asset) {
+  VKA_PROFILE_ZONE("VulkanController::create_texture_image");
+  const vka::KtxTexture &texture = asset.texture;
+  const uint32_t mip_level_count = asset.mip_level_count;
+
   texture_image_ = vka::create_image(
-      *device_, texture_.width, texture_.height, vk::Format::eR8G8B8A8Unorm,
+      *device_, texture.width, texture.height, texture.format,
       vk::ImageTiling::eOptimal,
-      vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
+      vk::ImageUsageFlagBits::eTransferSrc |
+          vk::ImageUsageFlagBits::eTransferDst |
+          vk::ImageUsageFlagBits::eSampled,
+      mip_level_count);
 
   texture_image_memory_ = vka::allocate_image_memory(
-      *device_, *texture_image_, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-  (*device_).bindImageMemory(*texture_image_, *texture_image_memory_, 0);
+      *device_, *texture_image_, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageTiling::eOptimal,
+      "texture_image");
 
-  const uint32_t size = static_cast<uint32_t>(texture_.size);
+  (*device_).bindImageMemory(*texture_image_, texture_image_memory_.memory,
+                             texture_image_memory_.offset);
 
-  vk::UniqueBuffer staging_buffer =
-      vka::create_buffer(*device_, size, vk::BufferUsageFlagBits::eTransferSrc);
-
-  vk::UniqueDeviceMemory staging_buffer_memory = vka::allocate_buffer_memory(
-      *device_, *staging_buffer, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eHostVisible |
-          vk::MemoryPropertyFlagBits::eHostCoherent);
-
-  (*device_).bindBufferMemory(*staging_buffer, *staging_buffer_memory, 0);
+  upload_context_.upload_image(texture.levels, *texture_image_,
+                               mip_level_count);
 
-  vka::fill_buffer(*device_, *staging_buffer_memory, texture_);
-
-  vka::transition_image_layout(
-      *device_, *command_pool_, queue_index_, vk::ImageLayout::eUndefined,
-      vk::ImageLayout::eTransferDstOptimal, *texture_image_);
-  vka::copy_buffer_to_image(*device_, *staging_buffer, *texture_image_,
-                            texture_.width, texture_.height, *command_pool_,
-                            queue_index_);
-  vka::transition_image_layout(*device_, *command_pool_, queue_index_,
-                               vk::ImageLayout::eTransferDstOptimal,
-                               vk::ImageLayout::eShaderReadOnlyOptimal,
-                               *texture_image_);
-
-  texture_image_view_ =
-      vka::create_texture_image_view(*device_, *texture_image_);
+  texture_image_view_ = vka::create_texture_image_view(
+      *device_, *texture_image_, texture.format, mip_level_count);
 }
 void VulkanController::create_depth_image() {
-  depth_image_ =
-      vka::create_image(*device_, texture_.width, texture_.height,
-                        vk::Format::eD32Sfloat, vk::ImageTiling::eOptimal,
-                        vk::ImageUsageFlagBits::eDepthStencilAttachment);
+  VKA_PROFILE_ZONE("VulkanController::create_depth_image");
+  depth_image_ = vka::create_image(
+      *device_, swapchain_extent_.width, swapchain_extent_.height,
+      vk::Format::eD32Sfloat, vk::ImageTiling::eOptimal,
+      vk::ImageUsageFlagBits::eDepthStencilAttachment, 1);
 
+  memory_allocator_.free(depth_image_memory_);
   depth_image_memory_ = vka::allocate_image_memory(
-      *device_, *depth_image_, physical_device_.getMemoryProperties(),
-      vk::MemoryPropertyFlagBits::eDeviceLocal);
+      *device_, *depth_image_, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageTiling::eOptimal,
+      "depth_image");
 
-  (*device_).bindImageMemory(*depth_image_, *depth_image_memory_, 0);
+  (*device_).bindImageMemory(*depth_image_, depth_image_memory_.memory,
+                             depth_image_memory_.offset);
 
-  vka::transition_image_layout(
-      *device_, *command_pool_, queue_index_, vk::ImageLayout::eUndefined,
-      vk::ImageLayout::eDepthStencilAttachmentOptimal, *depth_image_);
+  vka::record_transition_image_layout(
+      upload_context_.get_command_buffer(), vk::ImageLayout::eUndefined,
+      vk::ImageLayout::eDepthStencilAttachmentOptimal, *depth_image_, 1);
 
   depth_image_view_ =
       vka::create_image_view(*device_, *depth_image_, vk::Format::eD32Sfloat,
-                             vk::ImageAspectFlagBits::eDepth);
+                             vk::ImageAspectFlagBits::eDepth, 1);
+}
+void VulkanController::create_offscreen_images() {
+  is_offscreen_image_rendered_ = false;
+  color_image_views_.clear();
+  for (auto &image_memory : offscreen_image_memories_) {
+    memory_allocator_.free(image_memory);
+  }
+  offscreen_images_.resize(frames_.size());
+  offscreen_image_memories_.resize(frames_.size());
+  color_image_views_.resize(frames_.size());
+  for (size_t i = 0; i < frames_.size(); ++i) {
+    offscreen_images_[i] = vka::create_image(
+        *device_, swapchain_extent_.width, swapchain_extent_.height,
+        surface_format_.format, vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eColorAttachment |
+            vk::ImageUsageFlagBits::eTransferSrc,
+        1);
+
+    offscreen_image_memories_[i] = vka::allocate_image_memory(
+        *device_, *offscreen_images_[i], memory_allocator_,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageTiling::eOptimal,
+        "offscreen_image");
+
+    (*device_).bindImageMemory(*offscreen_images_[i],
+                               offscreen_image_memories_[i].memory,
+                               offscreen_image_memories_[i].offset);
+
+    color_image_views_[i] = vka::create_image_view(
+        *device_, *offscreen_images_[i], surface_format_.format,
+        vk::ImageAspectFlagBits::eColor, 1);
+  }
 }
 void VulkanController::recreate_swapchain(vk::Extent2D swapchain_extent) {
+  VKA_PROFILE_ZONE("VulkanController::recreate_swapchain");
+  (*device_).waitIdle();
   swapchain_extent_ = swapchain_extent;
 
-  const vk::SurfaceCapabilitiesKHR capabilities =
-      physical_device_.getSurfaceCapabilitiesKHR(*surface_);
-  swapchain_extent_ = vka::select_swapchain_extent(
-      capabilities, swapchain_extent_.width, swapchain_extent_.height);
+  if (surface_) {
+    const vk::SurfaceCapabilitiesKHR capabilities =
+        physical_device_.getSurfaceCapabilitiesKHR(*surface_);
+    swapchain_extent_ = vka::select_swapchain_extent(
+        capabilities, swapchain_extent_.width, swapchain_extent_.height);
 
-  swapchain_ =
-      vka::create_swapchain(surface_format_, swapchain_extent_, capabilities,
-                            *device_, *surface_, *swapchain_);
+    const vk::PresentModeKHR present_mode = vka::select_present_mode(
+        physical_device_.getSurfacePresentModesKHR(*surface_),
+        settings_.present_mode);
 
-  std::vector<vk::Image> swapchain_images =
-      (*device_).getSwapchainImagesKHR(*swapchain_);
+    swapchain_ =
+        vka::create_swapchain(surface_format_, swapchain_extent_, capabilities,
+                              *device_, *surface_, *swapchain_, present_mode);
 
-  swapchain_image_views_ = vka::create_swapchain_image_views(
-      *device_, swapchain_images, surface_format_);
+    std::vector<vk::Image> swapchain_images =
+        (*device_).getSwapchainImagesKHR(*swapchain_);
 
-  std::vector<vk::ImageView> swapchain_image_view_pointers;
-  for (const auto &image_view : swapchain_image_views_) {
-    swapchain_image_view_pointers.push_back(*image_view);
+    color_image_views_ = vka::create_swapchain_image_views(
+        *device_, swapchain_images, surface_format_);
+  } else {
+    create_offscreen_images();
   }
 
-  render_pass_ = vka::create_render_pass(*device_, surface_format_.format);
-
-  std::vector<vk::DescriptorSet> descriptor_set_pointers;
-  for (const auto &descriptor_set : descriptor_sets_) {
-    descriptor_set_pointers.push_back(*descriptor_set);
+  std::vector<vk::ImageView> color_image_view_pointers;
+  for (const auto &image_view : color_image_views_) {
+    color_image_view_pointers.push_back(*image_view);
   }
 
-  pipeline_layout_ =
-      vka::create_pipeline_layout(*device_, *descriptor_set_layout_);
-
-  graphics_pipeline_ = vka::create_graphics_pipeline(
-      *device_, *render_pass_, swapchain_extent_, *pipeline_layout_);
-
   create_depth_image();
 
   framebuffers_ = vka::create_framebuffers(
-      *device_, *render_pass_, swapchain_extent_, swapchain_image_view_pointers,
+      *device_, *render_pass_, swapchain_extent_, color_image_view_pointers,
       *depth_image_view_);
 
-  std::vector<vk::Framebuffer> framebuffer_pointers;
-  for (const auto &framebuffer : framebuffers_) {
-    framebuffer_pointers.push_back(*framebuffer);
-  }
-
-  command_buffers_ = vka::create_command_buffers(
-      *device_, *command_pool_, static_cast<uint32_t>(framebuffers_.size()));
-
-  std::vector<vk::CommandBuffer> command_buffer_pointers;
-  for (const auto &command_buffer : command_buffers_) {
-    command_buffer_pointers.push_back(*command_buffer);
-  }
-
-  vka::record_command_buffers(
-      *device_, command_buffer_pointers, *render_pass_, *graphics_pipeline_,
-      *pipeline_layout_, framebuffer_pointers, swapchain_extent_,
-      *vertex_buffer_, *index_buffer_, indices_, descriptor_set_pointers);
+  upload_context_.submit();
+  upload_context_.wait();
 }
 void VulkanController::update() {
+  VKA_PROFILE_ZONE("VulkanController::update");
   static auto start_time = std::chrono::high_resolution_clock::now();
   const auto current_time = std::chrono::high_resolution_clock::now();
   const float delta_time =
       vka::get_delta_time_per_second(start_time, current_time);
+  wait_for_frame();
   update_uniform_buffer(delta_time);
 }
 void VulkanController::draw() {
-  std::vector<vk::CommandBuffer> command_buffer_pointers;
-  for (const auto &command_buffer : command_buffers_) {
-    command_buffer_pointers.push_back(*command_buffer);
-  }
-  vk::SemaphoreCreateInfo semaphore_info;
-  vk::UniqueSemaphore is_image_available =
-      (*device_).createSemaphoreUnique(semaphore_info);
-  vk::UniqueSemaphore is_rendering_finished =
-      (*device_).createSemaphoreUnique(semaphore_info);
+  VKA_PROFILE_ZONE("VulkanController::draw");
+  if (!surface_) {
+    draw_offscreen();
+    return;
+  }
+  FrameResources &frame = frames_[current_frame_];
   try {
-    vka::draw_frame(*device_, *swapchain_, *is_image_available,
-                    *is_rendering_finished, command_buffer_pointers,
-                    queue_index_);
+    const uint32_t image_index = vka::acquire_next_image(
+        *device_, *swapchain_, *frame.is_image_available);
+
+    record_frame(frame, *framebuffers_[image_index]);
+
+    const vk::Fence is_frame_finished = *frame.is_frame_finished;
+    (*device_).resetFences(is_frame_finished);
+    vka::submit_frame(*device_, *frame.command_buffer,
+                      *frame.is_image_available, *frame.is_rendering_finished,
+                      *frame.is_frame_finished, queue_index_);
+    frame.has_timestamps = static_cast<bool>(timestamp_query_pool_);
+    frame.has_pipeline_statistics =
+        static_cast<bool>(pipeline_statistics_query_pool_);
+    current_frame_ =
+        (current_frame_ + 1) % static_cast<uint32_t>(frames_.size());
+
+    vka::present_frame(*device_, *swapchain_, image_index,
+                       *frame.is_rendering_finished, queue_index_);
   } catch (const vk::OutOfDateKHRError &e) {
-    vk::Queue queue = (*device_).getQueue(queue_index_, 0);
-    queue.waitIdle();
     recreate_swapchain(swapchain_extent_);
   }
 }
-void VulkanController::release_swapchain() {
-  depth_image_view_.release();
-  depth_image_.release();
-  depth_image_memory_.release();
-
-  for (auto &framebuffer : framebuffers_) {
-    framebuffer.release();
+void VulkanController::draw_offscreen() {
+  VKA_PROFILE_ZONE("VulkanController::draw_offscreen");
+  FrameResources &frame = frames_[current_frame_];
+  record_frame(frame, *framebuffers_[current_frame_]);
+
+  const vk::Fence is_frame_finished = *frame.is_frame_finished;
+  (*device_).resetFences(is_frame_finished);
+  vka::submit_frame(*device_, *frame.command_buffer, vk::Semaphore(),
+                    vk::Semaphore(), *frame.is_frame_finished, queue_index_);
+  is_offscreen_image_rendered_ = true;
+  frame.has_timestamps = static_cast<bool>(timestamp_query_pool_);
+  frame.has_pipeline_statistics =
+      static_cast<bool>(pipeline_statistics_query_pool_);
+  current_frame_ =
+      (current_frame_ + 1) % static_cast<uint32_t>(frames_.size());
+}
+void VulkanController::wait_idle() { (*device_).waitIdle(); }
+std::vector<uint8_t> VulkanController::read_pixels() {
+  if (surface_ || offscreen_images_.empty()) {
+    throw std::runtime_error("Pixels can be read only in headless mode");
+  }
+  if (!is_offscreen_image_rendered_) {
+    throw std::runtime_error("Pixels can be read only after a frame is drawn");
   }
+  const uint32_t frame_count = static_cast<uint32_t>(frames_.size());
+  const uint32_t last_frame = (current_frame_ + frame_count - 1) % frame_count;
+  const vk::Fence is_frame_finished = *frames_[last_frame].is_frame_finished;
+  (*device_).waitForFences(is_frame_finished, VK_TRUE, UINT64_MAX);
 
-  for (auto &command_buffer : command_buffers_) {
-    command_buffer.release();
+  const uint32_t size = swapchain_extent_.width * swapchain_extent_.height * 4;
+
+  vk::UniqueBuffer readback_buffer = vka::create_buffer(
+      *device_, size, vk::BufferUsageFlagBits::eTransferDst);
+
+  vka::MemoryAllocation readback_buffer_memory = vka::allocate_buffer_memory(
+      *device_, *readback_buffer, memory_allocator_,
+      vk::MemoryPropertyFlagBits::eHostVisible |
+          vk::MemoryPropertyFlagBits::eHostCoherent,
+      "readback_buffer");
+
+  (*device_).bindBufferMemory(*readback_buffer, readback_buffer_memory.memory,
+                              readback_buffer_memory.offset);
+
+  vka::record_copy_image_to_buffer(
+      upload_context_.get_command_buffer(), *offscreen_images_[last_frame],
+      *readback_buffer, swapchain_extent_.width, swapchain_extent_.height);
+  upload_context_.submit();
+  upload_context_.wait();
+
+  std::vector<uint8_t> pixels(readback_buffer_memory.data,
+                             readback_buffer_memory.data + size);
+  memory_allocator_.free(readback_buffer_memory);
+  return pixels;
+}
+std::vector<MemoryHeapStatistics>
+VulkanController::get_memory_statistics() const {
+  std::vector<MemoryHeapStatistics> statistics =
+      memory_allocator_.get_heap_statistics();
+  if (is_memory_budget_enabled_) {
+    vka::query_memory_budget(*instance_, physical_device_, statistics);
   }
+  return statistics;
+}
+std::vector<MemoryResourceStatistics>
+VulkanController::get_memory_resource_statistics() const {
+  return memory_allocator_.get_resource_statistics();
+}
+void VulkanController::release_swapchain() {
+  depth_image_view_.reset();
+  depth_image_.reset();
+  memory_allocator_.free(depth_image_memory_);
 
-  graphics_pipeline_.release();
-  pipeline_layout_.release();
-  render_pass_.release();
+  framebuffers_.clear();
+  color_image_views_.clear();
 
-  for (auto &image_view : swapchain_image_views_) {
-    image_view.release();
+  offscreen_images_.clear();
+  for (auto &image_memory : offscreen_image_memories_) {
+    memory_allocator_.free(image_memory);
   }
+  offscreen_image_memories_.clear();
 
-  swapchain_.release();
+  swapchain_.reset();
 }
 void VulkanController::release() {
+  if (device_) {
+    (*device_).waitIdle();
+  }
+  save_pipeline_cache();
+  recording_threads_.release();
   release_swapchain();
-  texture_sampler_.release();
-  texture_image_view_.release();
-  texture_image_.release();
-  texture_image_memory_.release();
-  index_buffer_.release();
-  index_buffer_memory_.release();
-  vertex_buffer_.release();
-  vertex_buffer_memory_.release();
-  uniform_buffer_.release();
-  uniform_buffer_memory_.release();
-  for (auto &descriptor_set : descriptor_sets_) {
-    descriptor_set.release();
-  }
-  descriptor_set_layout_.release();
-  descriptor_pool_.release();
-  command_pool_.release();
-  device_.release();
-  surface_.release();
-  instance_.release();
+  graphics_pipeline_.reset();
+  pipeline_layout_.reset();
+  render_pass_.reset();
+  texture_sampler_.reset();
+  texture_image_view_.reset();
+  texture_image_.reset();
+  memory_allocator_.free(texture_image_memory_);
+  visible_instance_buffer_.reset();
+  memory_allocator_.free(visible_instance_buffer_memory_);
+  instance_buffer_.reset();
+  memory_allocator_.free(instance_buffer_memory_);
+  index_buffer_.reset();
+  memory_allocator_.free(index_buffer_memory_);
+  vertex_buffer_.reset();
+  memory_allocator_.free(vertex_buffer_memory_);
+  for (auto &frame : frames_) {
+    frame.secondary_command_buffers.clear();
+    frame.secondary_command_pools.clear();
+    frame.is_rendering_finished.reset();
+    frame.is_image_available.reset();
+    frame.is_frame_finished.reset();
+    frame.command_buffer.reset();
+    frame.command_pool.reset();
+  }
+  uniform_buffer_.buffer.reset();
+  memory_allocator_.free(uniform_buffer_.memory);
+  uniform_buffer_.data = nullptr;
+  pipeline_cache_.reset();
+  descriptor_set_layout_.reset();
+  descriptor_allocator_.release();
+  upload_context_.release();
+  timestamp_query_pool_.reset();
+  pipeline_statistics_query_pool_.reset();
+  if (device_) {
+    if (settings_.is_memory_report_enabled) {
+      std::clog << vka::format_memory_report(get_memory_statistics(),
+                                             get_memory_resource_statistics());
+    }
+    for (const auto &resource : get_memory_resource_statistics()) {
+      if (resource.live_count > 0) {
+        std::cerr << "Leaked " << resource.live_count << " allocations ("
+                  << resource.live_size << " bytes) of " << resource.name
+                  << "\n";
+      }
+    }
+  }
+  memory_allocator_.release();
+  device_.reset();
+  // Surfaces created by GLFW are wrapped without an owning instance
+  if (surface_) {
+    (*instance_).destroySurfaceKHR(surface_.release());
+  }
+  instance_.reset();
+}
+ControllerSettings get_application_controller_settings() {
+  ControllerSettings settings;
+  settings.pipeline_cache_file_name = "pipeline_cache.bin";
+  return settings;
 }
+TriangleApplication::TriangleApplication()
+    : vulkan_controller_(get_application_controller_settings()),
+      window_(nullptr) {}
 void TriangleApplication::run() {
   const std::string application_name = "Triangle";
   const vka::Version application_version = {0, 1, 0};
@@ -1262,6 +4426,7 @@ void TriangleApplication::run() {
     extension_names.push_back(glfw_extensions[i]);
   }
   extension_names.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+  add_memory_budget_instance_extension(extension_names);
   std::vector<const char *> layer_names = {
       "VK_LAYER_LUNARG_standard_validation"};
 
@@ -1287,6 +4452,39 @@ void TriangleApplication::run() {
   glfwDestroyWindow(window_);
   glfwTerminate();
 }
+void TriangleApplication::run_headless(const uint32_t frame_count) {
+  const std::string application_name = "Triangle";
+  const vka::Version application_version = {0, 1, 0};
+  const uint32_t width = 500;
+  const uint32_t height = 500;
+
+  std::vector<const char *> extension_names =
+      vka::select_available_extension_names(
+          {VK_EXT_DEBUG_REPORT_EXTENSION_NAME},
+          vk::enumerateInstanceExtensionProperties());
+  const bool is_debug_report_enabled = !extension_names.empty();
+  add_memory_budget_instance_extension(extension_names);
+  std::vector<const char *> layer_names = vka::select_available_layer_names(
+      {"VK_LAYER_LUNARG_standard_validation"},
+      vk::enumerateInstanceLayerProperties());
+
+  vk::UniqueInstance instance = vka::create_instance(
+      application_name, application_version, extension_names, layer_names);
+
+  vk::UniqueDebugReportCallbackEXT debug_report_callback;
+  if (is_debug_report_enabled) {
+    debug_report_callback =
+        vka::create_debug_report_callback(*instance, nullptr);
+  }
+
+  vulkan_controller_.initialize(std::move(instance),
+                                vk::Extent2D(width, height));
+
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    vulkan_controller_.update();
+    vulkan_controller_.draw();
+  }
+}
 void TriangleApplication::recreate_swapchain() {
   int width, height;
   glfwGetWindowSize(window_, &width, &height);
@@ -26,6 +26,15 @@
 #include <vulkan/vulkan.hpp>
 
 #include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 
 namespace vka {
 struct Texture {
@@ -36,6 +45,11 @@ struct Texture {
   Texture();
   Texture(const std::string &file_name);
 };
+double get_elapsed_milliseconds(
+    const std::chrono::time_point<std::chrono::high_resolution_clock>
+        start_time,
+    const std::chrono::time_point<std::chrono::high_resolution_clock>
+        end_time);
 float get_delta_time_per_second(
     const std::chrono::time_point<std::chrono::high_resolution_clock>
         start_time,
@@ -47,19 +61,266 @@ struct Vertex {
   glm::vec2 texture_coordinates;
   bool operator==(const Vertex &other) const;
 };
+uint64_t hash_vertex(const Vertex &vertex);
+class ThreadPool {
+public:
+  ThreadPool() = default;
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  void initialize(const size_t thread_count);
+  void run(const std::function<void(const size_t)> &function);
+  size_t get_thread_count() const;
+  void release();
+
+private:
+  void work(const size_t thread_index, size_t generation);
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable is_work_ready_;
+  std::condition_variable is_work_finished_;
+  const std::function<void(const size_t)> *function_ = nullptr;
+  size_t generation_ = 0;
+  size_t pending_count_ = 0;
+  bool is_stopping_ = false;
+  std::exception_ptr exception_;
+};
+#ifdef VKA_ENABLE_PROFILER
+struct ProfileEvent {
+  const char *name;
+  uint32_t thread_index;
+  int64_t begin;
+  int64_t end;
+};
+class ProfileZone {
+public:
+  explicit ProfileZone(const char *name);
+  ~ProfileZone();
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+  const char *name_;
+  std::chrono::time_point<std::chrono::high_resolution_clock> start_time_;
+};
+std::vector<ProfileEvent> flush_profile_events();
+std::string to_chrome_trace(const std::vector<ProfileEvent> &events);
+void write_profile_trace(const std::string &file_name,
+                         const std::vector<ProfileEvent> &events);
+#define VKA_PROFILE_JOIN_NAME(prefix, line) prefix##line
+#define VKA_PROFILE_ZONE_NAME(line) VKA_PROFILE_JOIN_NAME(profile_zone_, line)
+#define VKA_PROFILE_ZONE(name)                                                 \
+  vka::ProfileZone VKA_PROFILE_ZONE_NAME(__LINE__)(name)
+#else
+#define VKA_PROFILE_ZONE(name)
+#endif
+void deduplicate_vertices(const std::vector<Vertex> &vertices,
+                          const uint32_t thread_count,
+                          std::vector<Vertex> &unique_vertices,
+                          std::vector<uint32_t> &indices);
+std::vector<Vertex> load_obj_vertices(const std::string &file_name);
 struct UniformBufferObject {
   glm::mat4 model;
   glm::mat4 view;
   glm::mat4 projection;
 };
+enum class TransformMode { uniform_buffer, push_constants };
+struct InstanceData {
+  glm::mat4 model;
+};
+std::vector<InstanceData> get_instance_grid(const uint32_t instance_count);
+const uint32_t max_short_index_vertex_count = 65536;
+struct SubMesh {
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+};
+void split_mesh(const uint32_t max_vertex_count, std::vector<Vertex> &vertices,
+                std::vector<uint32_t> &indices,
+                std::vector<SubMesh> &submeshes);
+uint32_t get_index_size(const vk::IndexType index_type);
+const uint32_t vertex_cache_size = 32;
+struct VertexCacheStatistics {
+  float acmr;
+  float atvr;
+};
+VertexCacheStatistics
+analyze_vertex_cache(const std::vector<uint32_t> &indices,
+                     const uint32_t vertex_count, const uint32_t cache_size);
+void optimize_vertex_cache(std::vector<uint32_t> &indices,
+                           const uint32_t vertex_count);
+void optimize_overdraw(const std::vector<Vertex> &vertices,
+                       std::vector<uint32_t> &indices,
+                       const uint32_t cache_size);
+void optimize_vertex_fetch(std::vector<Vertex> &vertices,
+                           std::vector<uint32_t> &indices);
+void optimize_mesh(std::vector<Vertex> &vertices,
+                   std::vector<uint32_t> &indices,
+                   const bool is_overdraw_optimized);
 struct Model {
   std::vector<Vertex> vertices;
   std::vector<uint32_t> indices;
+  std::vector<uint16_t> short_indices;
+  std::vector<SubMesh> submeshes;
   Model() = default;
-  Model(const std::string &file_name);
+  Model(const std::string &file_name, const bool is_optimized = true);
+};
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  bool open(const std::string &file_name);
+  void close();
+  const uint8_t *data() const;
+  size_t size() const;
+
+private:
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#endif
+};
+uint64_t hash_fnv1a(const uint8_t *data, const size_t size);
+uint64_t hash_file(const std::string &file_name);
+const uint32_t mesh_cache_magic = 0x4d414b56;
+const uint32_t mesh_cache_version = 3;
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint32_t vertex_size;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t index_size;
+  uint32_t submesh_count;
+  uint32_t reserved;
+};
+struct MeshView {
+  const Vertex *vertices;
+  uint32_t vertex_count;
+  const void *indices;
+  uint32_t index_count;
+  vk::IndexType index_type;
+  const SubMesh *submeshes;
+  uint32_t submesh_count;
+};
+MeshView get_mesh_view(const Model &model);
+std::vector<SubMesh> get_submeshes(const MeshView &mesh);
+void write_mesh_cache(const std::string &file_name, const uint64_t source_hash,
+                      const Model &model);
+bool read_mesh_cache(const MappedFile &file, const uint64_t source_hash,
+                     MeshView &mesh);
+MeshView load_mesh(const std::string &file_name, MappedFile &cache_file,
+                   Model &model);
+struct BoundingBox {
+  glm::vec3 minimum;
+  glm::vec3 maximum;
+};
+BoundingBox compute_bounding_box(const MeshView &mesh);
+struct BoundingSphere {
+  glm::vec3 center;
+  float radius;
+};
+BoundingSphere compute_bounding_sphere(const MeshView &mesh);
+enum class VertexLayout { full, compact, quantized };
+struct CompactVertex {
+  glm::vec3 position;
+  uint16_t texture_coordinates[2];
+};
+struct QuantizedVertex {
+  uint16_t position[4];
+  uint16_t texture_coordinates[2];
+};
+uint16_t pack_half(const float value);
+uint32_t get_vertex_size(const VertexLayout layout);
+std::vector<uint8_t> pack_vertices(const MeshView &mesh,
+                                   const VertexLayout layout,
+                                   const BoundingBox &bounds);
+glm::mat4 get_dequantization_matrix(const VertexLayout layout,
+                                    const BoundingBox &bounds);
+std::string get_vertex_shader_file_name(const VertexLayout layout,
+                                        const TransformMode transform_mode);
+struct InstanceBounds {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> radius;
+};
+InstanceBounds get_instance_bounds(const std::vector<InstanceData> &instances,
+                                   const BoundingSphere &bounds);
+struct Frustum {
+  glm::vec4 planes[6];
 };
-vk::VertexInputBindingDescription get_binding_description();
-std::vector<vk::VertexInputAttributeDescription> get_attribute_descriptions();
+Frustum extract_frustum(const glm::mat4 &matrix);
+void cull_instances(const Frustum &frustum, const InstanceBounds &bounds,
+                    std::vector<uint32_t> &visible_instances);
+struct ImageLevel {
+  const uint8_t *data;
+  uint32_t size;
+  uint32_t width;
+  uint32_t height;
+};
+struct KtxFormat {
+  vk::Format format;
+  uint32_t gl_type;
+  uint32_t gl_format;
+  uint32_t gl_internal_format;
+  uint32_t block_size;
+  bool is_compressed;
+};
+struct KtxTexture {
+  vk::Format format;
+  uint32_t width;
+  uint32_t height;
+  std::vector<ImageLevel> levels;
+};
+const std::vector<KtxFormat> &get_ktx_formats();
+uint32_t get_mip_level_count(const uint32_t width, const uint32_t height);
+uint32_t get_image_level_size(const vk::Format format, const uint32_t width,
+                              const uint32_t height);
+std::vector<uint8_t> downsample_rgba8(const uint8_t *data,
+                                      const uint32_t width,
+                                      const uint32_t height);
+std::vector<std::vector<uint8_t>>
+generate_mipmaps_rgba8(const uint8_t *data, const uint32_t width,
+                       const uint32_t height);
+void compress_bc1_block(const uint8_t *block, uint8_t *output);
+void compress_bc3_block(const uint8_t *block, uint8_t *output);
+std::vector<uint8_t> compress_rgba8(const uint8_t *data, const uint32_t width,
+                                    const uint32_t height,
+                                    const vk::Format format);
+void write_ktx(const std::string &file_name, const vk::Format format,
+               const std::vector<ImageLevel> &levels);
+bool read_ktx(const MappedFile &file, KtxTexture &texture);
+struct MeshAsset {
+  MappedFile cache_file;
+  Model model;
+  MeshView mesh;
+  BoundingSphere bounds;
+  std::vector<uint8_t> vertex_data;
+  glm::mat4 dequantization;
+};
+struct TextureAsset {
+  MappedFile file;
+  Texture image;
+  KtxTexture texture;
+  std::vector<std::vector<uint8_t>> generated_levels;
+  uint32_t mip_level_count;
+};
+std::unique_ptr<MeshAsset> load_mesh_asset(const std::string &file_name,
+                                           const VertexLayout layout);
+std::unique_ptr<TextureAsset>
+load_texture_asset(const vk::PhysicalDevice &physical_device,
+                   const std::vector<std::string> &file_names,
+                   const std::string &fallback_file_name);
+std::vector<vk::VertexInputBindingDescription>
+get_binding_descriptions(const VertexLayout layout);
+std::vector<vk::VertexInputAttributeDescription>
+get_attribute_descriptions(const VertexLayout layout);
 struct Version {
   uint32_t major;
   uint32_t minor;
@@ -71,15 +332,26 @@ vk::UniqueInstance
 create_instance(const std::string &name, const Version version,
                 const std::vector<const char *> &required_extension_names,
                 const std::vector<const char *> &required_layer_names);
+std::vector<const char *>
+select_available_layer_names(const std::vector<const char *> &layer_names,
+                             const std::vector<vk::LayerProperties> &layers);
+std::vector<const char *> select_available_extension_names(
+    const std::vector<const char *> &extension_names,
+    const std::vector<vk::ExtensionProperties> &extensions);
 vk::PhysicalDevice
 select_physical_device(const std::vector<vk::PhysicalDevice> &devices);
 uint32_t find_graphics_queue_family_index(
     const std::vector<vk::QueueFamilyProperties> &queues);
-vk::UniqueDevice create_device(const vk::PhysicalDevice &physical_device,
-                               const uint32_t queue_index);
+vk::UniqueDevice
+create_device(const vk::PhysicalDevice &physical_device,
+              const uint32_t queue_index,
+              const std::vector<const char *> &extension_names);
 vk::UniqueCommandPool create_command_pool(const vk::Device &device,
                                           const uint32_t queue_index);
-vk::UniqueBuffer create_buffer(const vk::Device &device, const uint32_t size,
+vk::UniqueFence create_fence(const vk::Device &device, const bool is_signaled);
+vk::UniqueSemaphore create_semaphore(const vk::Device &device);
+vk::UniqueBuffer create_buffer(const vk::Device &device,
+                               const vk::DeviceSize size,
                                const vk::BufferUsageFlags usage);
 uint32_t find_memory_type(
     const vk::PhysicalDeviceMemoryProperties physical_device_memory_properties,
@@ -89,6 +361,109 @@ vk::UniqueDeviceMemory allocate_buffer_memory(
     const vk::Device &device, const vk::Buffer &buffer,
     const vk::PhysicalDeviceMemoryProperties &physical_device_memory_properties,
     const vk::MemoryPropertyFlags &buffer_memory_properties);
+vk::DeviceSize align_size(const vk::DeviceSize size,
+                          const vk::DeviceSize alignment);
+bool allocate_range(std::map<vk::DeviceSize, vk::DeviceSize> &free_ranges,
+                    const vk::DeviceSize size, const vk::DeviceSize alignment,
+                    vk::DeviceSize &offset);
+void free_range(std::map<vk::DeviceSize, vk::DeviceSize> &free_ranges,
+                const vk::DeviceSize offset, const vk::DeviceSize size);
+struct MemoryBlock {
+  vk::UniqueDeviceMemory memory;
+  vk::DeviceSize size;
+  uint32_t memory_type_index;
+  bool is_linear;
+  uint8_t *data;
+  uint32_t allocation_count;
+  std::map<vk::DeviceSize, vk::DeviceSize> free_ranges;
+};
+struct MemoryAllocation {
+  vk::DeviceMemory memory;
+  vk::DeviceSize offset = 0;
+  vk::DeviceSize size = 0;
+  uint8_t *data = nullptr;
+  MemoryBlock *block = nullptr;
+  uint32_t resource_index = UINT32_MAX;
+};
+struct MemoryHeapStatistics {
+  vk::DeviceSize heap_size;
+  vk::DeviceSize allocated_size;
+  vk::DeviceSize used_size;
+  vk::DeviceSize peak_used_size;
+  vk::DeviceSize largest_free_range;
+  uint32_t block_count;
+  uint32_t allocation_count;
+  uint32_t free_range_count;
+  vk::DeviceSize budget;
+  vk::DeviceSize usage;
+};
+struct MemoryResourceStatistics {
+  std::string name;
+  uint32_t heap_index;
+  uint32_t memory_type_index;
+  vk::DeviceSize live_size;
+  vk::DeviceSize peak_size;
+  uint32_t live_count;
+  uint32_t allocation_count;
+};
+class MemoryAllocator {
+public:
+  void initialize(const vk::Device &device,
+                  const vk::PhysicalDevice &physical_device,
+                  const vk::DeviceSize block_size);
+  MemoryAllocation allocate(const vk::MemoryRequirements &requirements,
+                            const vk::MemoryPropertyFlags &properties,
+                            const bool is_linear, const std::string &name);
+  void free(MemoryAllocation &allocation);
+  std::vector<MemoryHeapStatistics> get_heap_statistics() const;
+  std::vector<MemoryResourceStatistics> get_resource_statistics() const;
+  void release();
+
+private:
+  vk::DeviceSize get_block_size(const uint32_t memory_type_index) const;
+  MemoryBlock &create_block(const uint32_t memory_type_index,
+                            const vk::DeviceSize size, const bool is_linear);
+  void release_block(const MemoryBlock *block);
+  uint32_t get_resource_index(const std::string &name,
+                              const uint32_t memory_type_index);
+  vk::Device device_;
+  vk::PhysicalDeviceMemoryProperties memory_properties_;
+  vk::DeviceSize block_size_;
+  std::vector<std::unique_ptr<MemoryBlock>> blocks_;
+  std::vector<MemoryResourceStatistics> resources_;
+  std::vector<vk::DeviceSize> heap_used_sizes_;
+  std::vector<vk::DeviceSize> heap_peak_sizes_;
+};
+MemoryAllocation
+allocate_buffer_memory(const vk::Device &device, const vk::Buffer &buffer,
+                       MemoryAllocator &allocator,
+                       const vk::MemoryPropertyFlags &buffer_memory_properties,
+                       const std::string &name);
+bool is_extension_available(
+    const std::vector<vk::ExtensionProperties> &extensions,
+    const std::string &name);
+void add_memory_budget_instance_extension(
+    std::vector<const char *> &extension_names);
+bool query_memory_budget(const vk::Instance &instance,
+                         const vk::PhysicalDevice &physical_device,
+                         std::vector<MemoryHeapStatistics> &heaps);
+std::string
+format_memory_report(const std::vector<MemoryHeapStatistics> &heaps,
+                     const std::vector<MemoryResourceStatistics> &resources);
+struct UniformRingBuffer {
+  vk::UniqueBuffer buffer;
+  MemoryAllocation memory;
+  uint8_t *data = nullptr;
+  vk::DeviceSize slice_size = 0;
+  uint32_t slices_per_frame = 0;
+};
+UniformRingBuffer create_uniform_ring_buffer(
+    const vk::Device &device, MemoryAllocator &allocator,
+    const vk::DeviceSize min_alignment, const vk::DeviceSize element_size,
+    const uint32_t frame_count, const uint32_t slices_per_frame);
+uint32_t get_uniform_slice_offset(const UniformRingBuffer &ring_buffer,
+                                  const uint32_t frame_index,
+                                  const uint32_t slice_index);
 template <typename T>
 void fill_buffer(const vk::Device &device,
                  const vk::DeviceMemory &buffer_memory, const T &data);
@@ -103,6 +478,18 @@ vk::UniqueCommandBuffer begin_command(const vk::Device &device,
 void end_command(const vk::Device &device,
                  vk::UniqueCommandBuffer command_buffer,
                  const uint32_t queue_index);
+void record_copy_buffer_to_buffer(const vk::CommandBuffer &command_buffer,
+                                  const vk::Buffer &source_buffer,
+                                  const vk::Buffer &destination_buffer,
+                                  const vk::DeviceSize size);
+void record_copy_buffer_to_image(const vk::CommandBuffer &command_buffer,
+                                 const vk::Buffer &source_buffer,
+                                 const vk::Image &destination_image,
+                                 const uint32_t width, const uint32_t height);
+void record_copy_image_to_buffer(const vk::CommandBuffer &command_buffer,
+                                 const vk::Image &source_image,
+                                 const vk::Buffer &destination_buffer,
+                                 const uint32_t width, const uint32_t height);
 void copy_buffer_to_buffer(const vk::Device &device,
                            const vk::Buffer &source_buffer,
                            const vk::Buffer &destination_buffer,
@@ -115,10 +502,20 @@ void copy_buffer_to_image(const vk::Device &device,
                           const uint32_t width, const uint32_t height,
                           const vk::CommandPool &command_pool,
                           const uint32_t queue_index);
+void copy_image_to_buffer(const vk::Device &device,
+                          const vk::Image &source_image,
+                          const vk::Buffer &destination_buffer,
+                          const uint32_t width, const uint32_t height,
+                          const vk::CommandPool &command_pool,
+                          const uint32_t queue_index);
 std::vector<vk::UniqueCommandBuffer>
 create_command_buffers(const vk::Device &device,
                        const vk::CommandPool &command_pool,
                        const uint32_t command_buffer_count);
+std::vector<vk::UniqueCommandBuffer>
+create_secondary_command_buffers(const vk::Device &device,
+                                 const vk::CommandPool &command_pool,
+                                 const uint32_t command_buffer_count);
 std::vector<vk::Bool32>
 get_presentation_support(const vk::PhysicalDevice &physical_device,
                          const vk::SurfaceKHR &surface,
@@ -131,27 +528,49 @@ select_surface_format(const std::vector<vk::SurfaceFormatKHR> &formats);
 vk::Extent2D
 select_swapchain_extent(const vk::SurfaceCapabilitiesKHR &capabilities,
                         uint32_t &width, uint32_t &height);
+vk::PresentModeKHR
+select_present_mode(const std::vector<vk::PresentModeKHR> &present_modes,
+                    const vk::PresentModeKHR &requested_present_mode);
 vk::UniqueSwapchainKHR create_swapchain(
     const vk::SurfaceFormatKHR &surface_format, const vk::Extent2D &extent,
     const vk::SurfaceCapabilitiesKHR &capabilities, const vk::Device &device,
-    const vk::SurfaceKHR &surface, const vk::SwapchainKHR &old_swapchain);
+    const vk::SurfaceKHR &surface, const vk::SwapchainKHR &old_swapchain,
+    const vk::PresentModeKHR &present_mode);
 vk::UniqueImageView create_image_view(const vk::Device &device,
                                       const vk::Image &image,
                                       const vk::Format &format,
-                                      const vk::ImageAspectFlags &aspect);
+                                      const vk::ImageAspectFlags &aspect,
+                                      const uint32_t mip_level_count);
 std::vector<vk::UniqueImageView>
 create_swapchain_image_views(const vk::Device &device,
                              const std::vector<vk::Image> images,
                              const vk::SurfaceFormatKHR &surface_format);
 std::vector<char> read_file(const std::string &file_name);
+void write_file(const std::string &file_name, const std::vector<char> &data);
+bool is_pipeline_cache_valid(const std::vector<char> &data,
+                             const vk::PhysicalDeviceProperties &properties);
+vk::UniquePipelineCache
+create_pipeline_cache(const vk::Device &device,
+                      const std::vector<char> &initial_data);
+std::vector<char> get_pipeline_cache_data(const vk::Device &device,
+                                          const vk::PipelineCache &cache);
 vk::UniqueShaderModule create_shader_module(const vk::Device &device,
                                             const std::vector<char> &code);
 vk::UniquePipelineLayout
 create_pipeline_layout(const vk::Device &device,
-                       const vk::DescriptorSetLayout &descriptor_set_layout);
+                       const vk::DescriptorSetLayout &descriptor_set_layout,
+                       const TransformMode transform_mode);
 vk::UniqueRenderPass create_render_pass(const vk::Device &device,
-                                        const vk::Format &surface_format);
-vk::UniqueDescriptorPool create_descriptor_pool(const vk::Device &device);
+                                        const vk::Format &surface_format,
+                                        const vk::ImageLayout &final_layout);
+std::vector<vk::DescriptorPoolSize> get_descriptor_set_sizes();
+vk::UniqueDescriptorPool
+create_descriptor_pool(const vk::Device &device,
+                       const std::vector<vk::DescriptorPoolSize> &set_sizes,
+                       const uint32_t max_sets,
+                       const vk::DescriptorPoolCreateFlags flags);
+vk::UniqueDescriptorPool create_descriptor_pool(const vk::Device &device,
+                                                const uint32_t max_sets);
 vk::UniqueDescriptorSetLayout
 create_descriptor_set_layout(const vk::Device &device);
 std::vector<vk::UniqueDescriptorSet>
@@ -163,16 +582,97 @@ void update_descriptor_sets(
     const std::vector<vk::DescriptorSet> &descriptor_sets,
     const vk::Buffer &uniform_buffer, const vk::ImageView &image_view,
     const vk::Sampler &sampler);
+class DescriptorAllocator {
+public:
+  void initialize(const vk::Device &device,
+                  const std::vector<vk::DescriptorPoolSize> &set_sizes,
+                  const uint32_t sets_per_pool, const uint32_t frame_count);
+  void begin_frame(const uint32_t frame_index);
+  std::vector<vk::DescriptorSet>
+  allocate(const vk::DescriptorSetLayout &descriptor_set_layout,
+           const uint32_t count);
+  uint32_t get_pool_count() const;
+  void release();
+
+private:
+  vk::UniqueDescriptorPool acquire_pool();
+  vk::Device device_;
+  std::vector<vk::DescriptorPoolSize> set_sizes_;
+  uint32_t sets_per_pool_ = 0;
+  uint32_t frame_index_ = 0;
+  std::vector<std::vector<vk::UniqueDescriptorPool>> frame_pools_;
+  std::vector<uint32_t> frame_set_counts_;
+  std::vector<vk::UniqueDescriptorPool> free_pools_;
+};
 vk::UniquePipeline
 create_graphics_pipeline(const vk::Device &device,
                          const vk::RenderPass &render_pass,
-                         const vk::Extent2D &swapchain_extent,
-                         const vk::PipelineLayout &pipeline_layout);
+                         const vk::PipelineLayout &pipeline_layout,
+                         const vk::PipelineCache &pipeline_cache,
+                         const VertexLayout vertex_layout,
+                         const TransformMode transform_mode);
 std::vector<vk::UniqueFramebuffer>
 create_framebuffers(const vk::Device &device, const vk::RenderPass &render_pass,
                     const vk::Extent2D &swapchain_extent,
                     const std::vector<vk::ImageView> &swapchain_image_views,
                     const vk::ImageView &depth_image_view);
+void begin_render_pass(const vk::CommandBuffer &command_buffer,
+                       const vk::RenderPass &render_pass,
+                       const vk::Framebuffer &framebuffer,
+                       const vk::Extent2D &swapchain_extent,
+                       const vk::SubpassContents contents);
+vk::UniqueQueryPool create_timestamp_query_pool(const vk::Device &device,
+                                                const uint32_t query_count);
+void record_timestamp_begin(const vk::CommandBuffer &command_buffer,
+                            const vk::QueryPool &query_pool,
+                            const uint32_t query);
+void record_timestamp_end(const vk::CommandBuffer &command_buffer,
+                          const vk::QueryPool &query_pool,
+                          const uint32_t query);
+bool read_timestamps(const vk::Device &device, const vk::QueryPool &query_pool,
+                     const uint32_t first_query, const uint32_t query_count,
+                     std::vector<uint64_t> &timestamps);
+double get_timestamp_milliseconds(const uint64_t begin, const uint64_t end,
+                                  const float timestamp_period,
+                                  const uint32_t timestamp_valid_bits);
+struct PipelineStatistics {
+  uint64_t input_assembly_vertices;
+  uint64_t input_assembly_primitives;
+  uint64_t vertex_shader_invocations;
+  uint64_t clipping_invocations;
+  uint64_t clipping_primitives;
+  uint64_t fragment_shader_invocations;
+};
+vk::QueryPipelineStatisticFlags get_pipeline_statistic_flags();
+vk::UniqueQueryPool
+create_pipeline_statistics_query_pool(const vk::Device &device,
+                                      const uint32_t query_count);
+void record_pipeline_statistics_begin(const vk::CommandBuffer &command_buffer,
+                                      const vk::QueryPool &query_pool,
+                                      const uint32_t query);
+void record_pipeline_statistics_end(const vk::CommandBuffer &command_buffer,
+                                    const vk::QueryPool &query_pool,
+                                    const uint32_t query);
+bool read_pipeline_statistics(const vk::Device &device,
+                              const vk::QueryPool &query_pool,
+                              const uint32_t query,
+                              PipelineStatistics &statistics);
+struct DrawCommand {
+  uint32_t dynamic_offset;
+  uint32_t instance_count;
+  uint32_t first_instance;
+};
+void record_draw_commands(
+    const vk::CommandBuffer &command_buffer,
+    const vk::Pipeline &graphics_pipeline,
+    const vk::PipelineLayout &pipeline_layout,
+    const vk::Extent2D &swapchain_extent, const vk::Buffer &vertex_buffer,
+    const vk::Buffer &instance_buffer, const vk::Buffer &index_buffer,
+    const vk::IndexType index_type, const std::vector<SubMesh> &submeshes,
+    const std::vector<vk::DescriptorSet> &descriptor_sets,
+    const std::vector<DrawCommand> &draw_commands,
+    const TransformMode transform_mode,
+    const std::vector<glm::mat4> &object_models);
 void record_command_buffers(
     const vk::Device &device,
     const std::vector<vk::CommandBuffer> &command_buffers,
@@ -180,49 +680,246 @@ void record_command_buffers(
     const vk::PipelineLayout &pipeline_layout,
     const std::vector<vk::Framebuffer> &framebuffers,
     const vk::Extent2D &swapchain_extent, const vk::Buffer &vertex_buffer,
-    const vk::Buffer &index_buffer, const std::vector<uint32_t> &indices,
-    const std::vector<vk::DescriptorSet> &descriptor_sets);
+    const vk::Buffer &instance_buffer, const vk::Buffer &index_buffer,
+    const vk::IndexType index_type, const std::vector<SubMesh> &submeshes,
+    const std::vector<vk::DescriptorSet> &descriptor_sets,
+    const std::vector<DrawCommand> &draw_commands,
+    const TransformMode transform_mode,
+    const std::vector<glm::mat4> &object_models,
+    const vk::QueryPool &timestamp_query_pool,
+    const uint32_t first_timestamp_query,
+    const vk::QueryPool &statistics_query_pool,
+    const uint32_t first_statistics_query);
+void record_secondary_command_buffer(
+    const vk::CommandBuffer &command_buffer, const vk::RenderPass &render_pass,
+    const vk::Framebuffer &framebuffer, const vk::Pipeline &graphics_pipeline,
+    const vk::PipelineLayout &pipeline_layout,
+    const vk::Extent2D &swapchain_extent, const vk::Buffer &vertex_buffer,
+    const vk::Buffer &instance_buffer, const vk::Buffer &index_buffer,
+    const vk::IndexType index_type, const std::vector<SubMesh> &submeshes,
+    const std::vector<vk::DescriptorSet> &descriptor_sets,
+    const std::vector<DrawCommand> &draw_commands,
+    const TransformMode transform_mode,
+    const std::vector<glm::mat4> &object_models,
+    const vk::QueryPipelineStatisticFlags pipeline_statistics);
+void record_primary_command_buffer(
+    const vk::CommandBuffer &command_buffer, const vk::RenderPass &render_pass,
+    const vk::Framebuffer &framebuffer, const vk::Extent2D &swapchain_extent,
+    const std::vector<vk::CommandBuffer> &secondary_command_buffers,
+    const vk::QueryPool &timestamp_query_pool, const uint32_t timestamp_query,
+    const vk::QueryPool &statistics_query_pool,
+    const uint32_t statistics_query);
+uint32_t acquire_next_image(const vk::Device &device,
+                            const vk::SwapchainKHR &swapchain,
+                            const vk::Semaphore &is_image_available);
+void submit_frame(const vk::Device &device,
+                  const vk::CommandBuffer &command_buffer,
+                  const vk::Semaphore &is_image_available,
+                  const vk::Semaphore &is_rendering_finished,
+                  const vk::Fence &is_frame_finished,
+                  const uint32_t queue_index);
+void present_frame(const vk::Device &device, const vk::SwapchainKHR &swapchain,
+                   const uint32_t image_index,
+                   const vk::Semaphore &is_rendering_finished,
+                   const uint32_t queue_index);
 void draw_frame(const vk::Device &device, const vk::SwapchainKHR &swapchain,
                 const vk::Semaphore &is_image_available,
                 const vk::Semaphore &is_rendering_finished,
+                const vk::Fence &is_frame_finished,
                 const std::vector<vk::CommandBuffer> &command_buffers,
                 const uint32_t queue_index);
 vk::UniqueImage create_image(const vk::Device &device, const uint32_t width,
                              const uint32_t height, const vk::Format format,
                              const vk::ImageTiling tiling,
-                             const vk::ImageUsageFlags usage);
+                             const vk::ImageUsageFlags usage,
+                             const uint32_t mip_level_count);
 vk::UniqueDeviceMemory allocate_image_memory(
     const vk::Device &device, const vk::Image &image,
     const vk::PhysicalDeviceMemoryProperties &physical_device_memory_properties,
     const vk::MemoryPropertyFlags &image_memory_properties);
+MemoryAllocation
+allocate_image_memory(const vk::Device &device, const vk::Image &image,
+                      MemoryAllocator &allocator,
+                      const vk::MemoryPropertyFlags &image_memory_properties,
+                      const vk::ImageTiling &tiling, const std::string &name);
+void record_transition_image_layout(const vk::CommandBuffer &command_buffer,
+                                    const vk::ImageLayout old_layout,
+                                    const vk::ImageLayout new_layout,
+                                    const vk::Image &image,
+                                    const uint32_t mip_level_count);
+void record_generate_mipmaps(const vk::CommandBuffer &command_buffer,
+                             const vk::Image &image, const uint32_t width,
+                             const uint32_t height,
+                             const uint32_t mip_level_count);
 void transition_image_layout(const vk::Device &device,
                              const vk::CommandPool &command_pool,
                              const uint32_t queue_index,
                              const vk::ImageLayout old_layout,
                              const vk::ImageLayout new_layout,
                              const vk::Image &image);
+struct UploadBatch {
+  vk::UniqueCommandBuffer command_buffer;
+  vk::UniqueFence is_finished;
+  std::vector<vk::UniqueBuffer> staging_buffers;
+  std::vector<MemoryAllocation> staging_memories;
+  uint32_t query = UINT32_MAX;
+};
+class UploadContext {
+public:
+  void initialize(const vk::Device &device, const uint32_t queue_index,
+                  MemoryAllocator &allocator);
+  void set_timestamp_queries(const vk::QueryPool &query_pool,
+                             const uint32_t first_query,
+                             const uint32_t query_count,
+                             const float timestamp_period,
+                             const uint32_t timestamp_valid_bits);
+  double get_upload_time() const;
+  vk::CommandBuffer get_command_buffer();
+  void upload_buffer(const void *data, const vk::DeviceSize size,
+                     const vk::Buffer &destination_buffer);
+  void upload_image(const std::vector<ImageLevel> &levels,
+                    const vk::Image &destination_image,
+                    const uint32_t mip_level_count);
+  void submit();
+  bool poll();
+  void wait();
+  void release();
+
+private:
+  vk::Buffer create_staging_buffer(const vk::DeviceSize size, void *&data);
+  vk::Device device_;
+  vk::Queue queue_;
+  MemoryAllocator *allocator_ = nullptr;
+  vk::UniqueCommandPool command_pool_;
+  std::unique_ptr<UploadBatch> recording_batch_;
+  std::vector<std::unique_ptr<UploadBatch>> pending_batches_;
+  vk::QueryPool query_pool_;
+  uint32_t first_query_ = 0;
+  uint32_t query_count_ = 0;
+  uint32_t next_query_ = 0;
+  float timestamp_period_ = 1.0f;
+  uint32_t timestamp_valid_bits_ = 0;
+  double upload_time_ = 0.0;
+};
 vk::UniqueImageView create_texture_image_view(const vk::Device &device,
-                                              const vk::Image &image);
+                                              const vk::Image &image,
+                                              const vk::Format format,
+                                              const uint32_t mip_level_count);
 vk::UniqueSampler create_texture_sampler(const vk::Device &device);
+bool is_linear_blit_supported(const vk::PhysicalDevice &physical_device,
+                              const vk::Format format);
+bool is_texture_format_supported(const vk::PhysicalDevice &physical_device,
+                                 const vk::Format format);
+struct FrameTimeStatistics {
+  double mean;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+};
+double get_percentile(const std::vector<double> &sorted_samples,
+                      const double percentile);
+FrameTimeStatistics
+compute_frame_time_statistics(std::vector<double> frame_times);
+struct StartupTimings {
+  double mesh_loading;
+  double texture_loading;
+  double device_creation;
+  double pipeline_creation;
+  double asset_wait;
+  double upload;
+  double total;
+};
+struct ControllerSettings {
+  uint32_t frames_in_flight = 2;
+  uint32_t instance_count = 1;
+  uint32_t object_count = 1;
+  uint32_t recording_thread_count = 1;
+  bool is_culling_enabled = true;
+  VertexLayout vertex_layout = VertexLayout::full;
+  TransformMode transform_mode = TransformMode::uniform_buffer;
+  vk::DeviceSize memory_block_size = 64 * 1024 * 1024;
+  std::string pipeline_cache_file_name;
+  vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+  bool is_pipeline_statistics_enabled = true;
+  bool is_memory_report_enabled = false;
+};
+struct FrameResources {
+  vk::UniqueCommandPool command_pool;
+  vk::UniqueCommandBuffer command_buffer;
+  vk::UniqueFence is_frame_finished;
+  vk::UniqueSemaphore is_image_available;
+  vk::UniqueSemaphore is_rendering_finished;
+  std::vector<vk::UniqueCommandPool> secondary_command_pools;
+  std::vector<vk::UniqueCommandBuffer> secondary_command_buffers;
+  bool has_timestamps = false;
+  bool has_pipeline_statistics = false;
+};
 class VulkanController {
 public:
-  VulkanController();
+  explicit VulkanController(
+      const ControllerSettings &settings = ControllerSettings());
   ~VulkanController();
   void initialize(vk::UniqueInstance instance, vk::UniqueSurfaceKHR surface,
                   const vk::Extent2D swapchain_extent);
+  void initialize(vk::UniqueInstance instance, const vk::Extent2D extent);
   void recreate_swapchain(vk::Extent2D swapchain_extent);
   void release();
   void release_swapchain();
   void update();
   void draw();
+  void wait_idle();
+  std::vector<uint8_t> read_pixels();
+  std::vector<MemoryHeapStatistics> get_memory_statistics() const;
+  std::vector<MemoryResourceStatistics> get_memory_resource_statistics() const;
+  bool is_pipeline_cache_warm() const;
+  void save_pipeline_cache();
+  StartupTimings get_startup_timings() const;
+  double get_recording_time() const;
+  double get_culling_time() const;
+  bool is_gpu_timing_supported() const;
+  double get_gpu_time() const;
+  double get_upload_time() const;
+  bool is_pipeline_statistics_supported() const;
+  PipelineStatistics get_pipeline_statistics() const;
+  void set_instance_count(const uint32_t instance_count);
 
 private:
+  void load_assets();
+  void add_memory_budget_extension(std::vector<const char *> &extension_names);
+  void initialize_resources();
+  void load_pipeline_cache();
+  void create_pipeline();
+  void create_frames();
+  void create_timestamp_query_pool();
+  void create_pipeline_statistics_query_pool();
+  void wait_for_frame();
+  void record_frame(FrameResources &frame, const vk::Framebuffer &framebuffer);
   void create_uniform_buffer();
   void update_uniform_buffer(const float delta_time);
-  void create_vertex_buffer();
-  void create_index_buffer();
-  void create_texture_image();
+  void create_vertex_buffer(const MeshAsset &asset);
+  void create_index_buffer(const MeshView &mesh);
+  void create_instance_buffer();
+  void cull_object(const glm::mat4 &matrix, const uint32_t object_index);
+  void create_texture_image(const TextureAsset &asset);
   void create_depth_image();
+  void create_offscreen_images();
+  void draw_offscreen();
+  ControllerSettings settings_;
+  uint32_t current_frame_;
+  bool is_pipeline_cache_warm_;
+  bool is_memory_budget_enabled_;
+  bool is_offscreen_image_rendered_;
+  double recording_time_;
+  double culling_time_;
+  double gpu_time_;
+  float timestamp_period_;
+  uint32_t timestamp_valid_bits_;
+  PipelineStatistics pipeline_statistics_;
+  StartupTimings startup_timings_;
+  std::chrono::time_point<std::chrono::high_resolution_clock> startup_time_;
+  std::future<std::unique_ptr<MeshAsset>> mesh_asset_;
+  std::future<std::unique_ptr<TextureAsset>> texture_asset_;
   vk::PhysicalDevice physical_device_;
   uint32_t queue_index_;
   vk::SurfaceFormatKHR surface_format_;
@@ -231,38 +928,56 @@ private:
   vk::UniqueInstance instance_;
   vk::UniqueSurfaceKHR surface_;
   vk::UniqueDevice device_;
-  vk::UniqueCommandPool command_pool_;
-  vk::UniqueDescriptorPool descriptor_pool_;
+  MemoryAllocator memory_allocator_;
+  UploadContext upload_context_;
+  DescriptorAllocator descriptor_allocator_;
   vk::UniqueDescriptorSetLayout descriptor_set_layout_;
-  std::vector<vk::UniqueDescriptorSet> descriptor_sets_;
+  vk::UniquePipelineCache pipeline_cache_;
+  vk::UniqueQueryPool timestamp_query_pool_;
+  vk::UniqueQueryPool pipeline_statistics_query_pool_;
+  std::vector<FrameResources> frames_;
+  ThreadPool recording_threads_;
+  UniformRingBuffer uniform_buffer_;
+  vk::Extent2D uniform_extent_;
   vk::UniqueSampler texture_sampler_;
-  Texture texture_;
   vk::UniqueImageView texture_image_view_;
   vk::UniqueImage texture_image_;
-  vk::UniqueDeviceMemory texture_image_memory_;
-  vk::UniqueBuffer uniform_buffer_;
-  vk::UniqueDeviceMemory uniform_buffer_memory_;
+  MemoryAllocation texture_image_memory_;
   vk::UniqueBuffer vertex_buffer_;
-  vk::UniqueDeviceMemory vertex_buffer_memory_;
+  MemoryAllocation vertex_buffer_memory_;
   vk::UniqueBuffer index_buffer_;
-  vk::UniqueDeviceMemory index_buffer_memory_;
+  MemoryAllocation index_buffer_memory_;
+  vk::UniqueBuffer instance_buffer_;
+  MemoryAllocation instance_buffer_memory_;
+  vk::UniqueBuffer visible_instance_buffer_;
+  MemoryAllocation visible_instance_buffer_memory_;
+  BoundingSphere mesh_bounds_;
+  glm::mat4 dequantization_;
+  std::vector<InstanceData> instances_;
+  InstanceBounds instance_bounds_;
+  std::vector<uint32_t> visible_instances_;
+  std::vector<DrawCommand> draw_commands_;
+  std::vector<glm::mat4> object_models_;
   vk::UniqueSwapchainKHR swapchain_;
-  std::vector<vk::UniqueImageView> swapchain_image_views_;
+  std::vector<vk::UniqueImage> offscreen_images_;
+  std::vector<MemoryAllocation> offscreen_image_memories_;
+  std::vector<vk::UniqueImageView> color_image_views_;
   vk::UniqueRenderPass render_pass_;
   vk::UniquePipelineLayout pipeline_layout_;
   vk::UniquePipeline graphics_pipeline_;
-  std::vector<vk::UniqueCommandBuffer> command_buffers_;
   std::vector<vk::UniqueFramebuffer> framebuffers_;
   vk::UniqueImageView depth_image_view_;
   vk::UniqueImage depth_image_;
-  vk::UniqueDeviceMemory depth_image_memory_;
+  MemoryAllocation depth_image_memory_;
 
-  std::vector<Vertex> vertices_;
-  std::vector<uint32_t> indices_;
+  vk::IndexType index_type_;
+  std::vector<SubMesh> submeshes_;
 };
 class TriangleApplication {
 public:
+  TriangleApplication();
   void run();
+  void run_headless(const uint32_t frame_count);
   void recreate_swapchain();
   static void resize(GLFWwindow *window, int width, int height);
 
@@ -274,10 +989,7 @@ private:
 namespace std {
 template <> struct hash<vka::Vertex> {
   size_t operator()(vka::Vertex const &vertex) const {
-    return ((hash<glm::vec3>()(vertex.position) ^
-             (hash<glm::vec3>()(vertex.color) << 1)) >>
-            1) ^
-           (hash<glm::vec2>()(vertex.texture_coordinates) << 1);
+    return static_cast<size_t>(vka::hash_vertex(vertex));
   }
 };
 } // namespace std